@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+struct MemoryBlock;
+
+// a range of some MemoryBlock, freed with Allocator::free
+struct Allocation {
+  vk::DeviceMemory memory{};
+  vk::DeviceSize offset = 0, size = 0;
+  // host address of offset, null unless the memory is host visible
+  void *mapped = nullptr;
+  MemoryBlock *block = nullptr;
+
+  explicit operator bool() const noexcept { return block; }
+};
+
+// what one memory heap holds at the moment
+struct HeapStats {
+  vk::MemoryHeapFlags flags;
+  vk::DeviceSize heap_size = 0;
+  // allocated from the driver
+  vk::DeviceSize reserved = 0;
+  // handed out to buffers, the rest of reserved is free or alignment padding
+  vk::DeviceSize used = 0;
+  vk::DeviceSize largest_free = 0;
+  uint32_t blocks = 0, allocations = 0;
+
+  // 0 when the free space is one range, towards 1 the more it's splintered
+  float fragmentation() const noexcept;
+};
+
+// one driver allocation carved up by Allocator
+struct MemoryBlock {
+  vk::DeviceMemory memory{};
+  vk::DeviceSize size = 0, used = 0;
+  void *mapped = nullptr;
+  uint32_t type = 0, allocations = 0;
+  bool linear = true, dedicated = false;
+  // offset to size of every free range
+  std::map<vk::DeviceSize, vk::DeviceSize> free;
+};
+
+// hands out ranges of a few large vk::DeviceMemory blocks per memory type
+// instead of a driver allocation per buffer. blocks are first fit free lists
+// that merge neighbouring ranges on free, host visible blocks stay mapped for
+// their whole life. linear and optimal resources never share a block, so
+// bufferImageGranularity never has to be padded for
+class Allocator {
+public:
+  Allocator(vk::Device device, vk::PhysicalDevice phys);
+  ~Allocator();
+  Allocator(const Allocator &) = delete;
+  Allocator &operator=(const Allocator &) = delete;
+
+  // memory for a resource with reqs in a type with properties, throws if no
+  // type has them or the heap is exhausted
+  Allocation allocate(const vk::MemoryRequirements &reqs,
+                      vk::MemoryPropertyFlags properties, bool linear = true);
+  void free(Allocation &allocation);
+
+  std::vector<HeapStats> stats() const;
+
+  vk::Device device;
+
+private:
+  // anything over half a block gets a block of its own, which goes back to
+  // the driver as soon as it's freed
+  vk::DeviceSize blockSize(uint32_t type) const;
+  MemoryBlock &grow(uint32_t type, bool linear, vk::DeviceSize size);
+
+  vk::PhysicalDeviceMemoryProperties properties;
+  std::list<MemoryBlock> blocks;
+  mutable std::mutex mutex;
+};
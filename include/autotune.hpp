@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+#include "context.hpp"
+#include "kernel.hpp"
+#include "options.hpp"
+
+struct Tuning {
+  Kernel kernel;
+  uint32_t work_size;
+};
+
+// the fastest kernel and workgroup size for the current world::constants on
+// context's device. with options.tune set to cached, the winner is looked up
+// under the device's uuid, the driver and the world first, otherwise every
+// candidate out of options.kernels and options.work_sizes that fits the
+// device is stepped for a moment and the winner saved. whatever was given on
+// the command line isn't tuned, and with tuning off the options are returned
+// as they are
+Tuning autotune(Context &context, const Options &options);
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "options.hpp"
+
+// steps every combination of options.counts, options.kernels and
+// options.work_sizes headless for about a second each and writes the
+// throughput to options.output with .csv and .json appended, returns the exit
+// code
+int runBench(const Options &options);
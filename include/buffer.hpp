@@ -1,102 +1,96 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
+#include <ranges>
 #include <span>
 #include <stdexcept>
 #include <vulkan/vulkan.hpp>
 
+#include "allocator.hpp"
 #include "context.hpp"
 
-inline uint32_t findMemoryType(vk::PhysicalDevice phys, uint32_t typeFilter,
-                               vk::MemoryPropertyFlags properties) {
-  auto memProperties = phys.getMemoryProperties();
-  for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-    if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags &
-                                    properties) == properties) {
-      return i;
-    }
-  }
+template <typename T>
+concept contiguous = std::ranges::contiguous_range<T>;
 
-  throw std::runtime_error("failed to find suitable memory type!");
+template <contiguous T> std::span<const uint8_t> bin(const T &in) {
+  return {reinterpret_cast<const uint8_t *>(in.data()),
+          in.size() * sizeof(in[0])};
+}
+template <typename T> std::span<const uint8_t> bin_view(const T &in) {
+  return {reinterpret_cast<const uint8_t *>(&in), sizeof(in)};
 }
 
 struct Buffer {
   vk::Buffer buffer{};
-  vk::DeviceMemory mem{};
-  vk::Device d{};
-  Buffer(vk::Device device, vk::PhysicalDevice phys, size_t size,
-         vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties) {
-    d = device;
-    buffer = d.createBuffer({.size = size,
-                             .usage = usage,
-                             .sharingMode = vk::SharingMode::eExclusive});
-    auto mem_reqs = d.getBufferMemoryRequirements(buffer);
-
-    mem = d.allocateMemory({.allocationSize = mem_reqs.size,
-                            .memoryTypeIndex = findMemoryType(
-                                phys, mem_reqs.memoryTypeBits, properties)});
-    d.bindBufferMemory(buffer, mem, 0);
+  Allocation mem{};
+  Allocator *alloc = nullptr;
+  // a buffer used by more than one queue family without ownership transfers
+  // lists them all in families
+  Buffer(Allocator &allocator, size_t size, vk::BufferUsageFlags usage,
+         vk::MemoryPropertyFlags properties,
+         std::span<const uint32_t> families = {}) {
+    alloc = &allocator;
+    auto d = alloc->device;
+    auto concurrent = families.size() > 1;
+    buffer = d.createBuffer(
+        {.size = size,
+         .usage = usage,
+         .sharingMode = concurrent ? vk::SharingMode::eConcurrent
+                                   : vk::SharingMode::eExclusive,
+         .queueFamilyIndexCount =
+             concurrent ? static_cast<uint32_t>(families.size()) : 0,
+         .pQueueFamilyIndices = concurrent ? families.data() : nullptr});
+    try {
+      mem = alloc->allocate(d.getBufferMemoryRequirements(buffer), properties);
+    } catch (...) {
+      d.destroyBuffer(buffer);
+      throw;
+    }
+    d.bindBufferMemory(buffer, mem.memory, mem.offset);
   }
 
   Buffer(Buffer &&other) {
     buffer = other.buffer;
     mem = other.mem;
-    d = other.d;
+    alloc = other.alloc;
     other.buffer = nullptr;
-    other.mem = nullptr;
-    other.d = nullptr;
+    other.mem = {};
+    other.alloc = nullptr;
   }
   ~Buffer() {
-    if (d) {
-      d.destroyBuffer(buffer);
-      d.freeMemory(mem);
+    if (alloc) {
+      alloc->device.destroyBuffer(buffer);
+      alloc->free(mem);
     }
   }
-
-  void write(vk::Device device, vk::PhysicalDevice phys, Renderer &vk,
-             std::span<const uint8_t> data) {
-
-    using enum vk::BufferUsageFlagBits;
-    using enum vk::MemoryPropertyFlagBits;
-    auto staging = Buffer(device, phys, data.size(), eTransferSrc,
-                          eHostVisible | eHostCoherent);
-
-    auto ptr = staging.d.mapMemory(staging.mem, 0, data.size());
-    std::memcpy(ptr, data.data(), data.size());
-    staging.d.unmapMemory(staging.mem);
-
-    auto cmdBuffers = vk.getCommands(1);
-    vk::CommandBufferBeginInfo info{};
-    vkassert(cmdBuffers[0].begin(&info));
-    cmdBuffers[0].copyBuffer(staging.buffer, buffer,
-                             vk::BufferCopy{0, 0, data.size()});
-    cmdBuffers[0].end();
-    vk.queues.mem().submit(std::array{vk::SubmitInfo{
-        .commandBufferCount = 1, .pCommandBuffers = cmdBuffers.data()}});
-    vk.queues.mem().waitIdle();
-  }
 };
 
+// holds count consecutive Ts
 template <typename T> struct MappedBuffer {
   Buffer buffer;
   void *mapped = nullptr;
+  size_t count = 1;
   MappedBuffer() = delete;
+  // the allocator keeps host visible memory mapped, so this only points
+  // into it
   MappedBuffer(
-      vk::Device d, vk::PhysicalDevice phys,
-      vk::BufferUsageFlags type = vk::BufferUsageFlagBits::eUniformBuffer)
-      : buffer(d, phys, sizeof(T), type,
+      Allocator &allocator,
+      vk::BufferUsageFlags type = vk::BufferUsageFlagBits::eUniformBuffer,
+      size_t count = 1, std::span<const uint32_t> families = {})
+      : buffer(allocator, count * sizeof(T), type,
                vk::MemoryPropertyFlagBits::eHostCoherent |
-                   vk::MemoryPropertyFlagBits::eHostVisible) {
-    mapped = buffer.d.mapMemory(buffer.mem, 0, sizeof(T));
-  }
+                   vk::MemoryPropertyFlagBits::eHostVisible,
+               families),
+        mapped(buffer.mem.mapped), count(count) {}
 
   MappedBuffer(MappedBuffer &&other)
-      : buffer(std::move(other.buffer)), mapped(other.mapped) {}
-
-  ~MappedBuffer() {
-    if (buffer.d)
-      buffer.d.unmapMemory(buffer.mem);
-  }
+      : buffer(std::move(other.buffer)), mapped(other.mapped),
+        count(other.count) {}
 
   void write(const T &data) { std::memcpy(mapped, &data, sizeof(T)); }
-  void read(T *out) { std::memcpy(out, mapped, sizeof(T)); }
+  void read(T *out) { std::memcpy(out, mapped, count * sizeof(T)); }
+  const T &operator[](size_t i) const {
+    return static_cast<const T *>(mapped)[i];
+  }
 };
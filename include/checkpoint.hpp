@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <span>
+
+#include "world.hpp"
+
+// first bytes of a checkpoint file, in host byte order. the arrays follow at
+// page aligned offsets so a mapping of the file can be handed to the staging
+// ring as is. version 2 packed the colors into rgba8
+struct CheckpointHeader {
+  static constexpr std::array<char, 8> file_magic = {'p', 'a', 'r', 't',
+                                                     's', 'i', 'm', 'c'};
+  static constexpr uint32_t current_version = 2;
+  static constexpr uint64_t alignment = 4096;
+
+  std::array<char, 8> magic = file_magic;
+  uint32_t version = current_version;
+  uint32_t count = 0;
+  float max_x = 0, max_y = 0;
+  // steps simulated before the checkpoint was taken
+  uint64_t step = 0;
+  // byte offsets from the start of the file
+  uint64_t pos = 0, vel = 0, color = 0, size = 0;
+};
+
+// a checkpoint file mapped read only, the arrays point straight into the
+// mapping
+class Checkpoint {
+public:
+  // throws if the file can't be mapped or isn't a checkpoint of this version
+  explicit Checkpoint(const std::filesystem::path &path);
+  ~Checkpoint();
+  Checkpoint(const Checkpoint &) = delete;
+  Checkpoint &operator=(const Checkpoint &) = delete;
+
+  const CheckpointHeader &header() const noexcept { return *head; }
+  std::span<const glm::vec2> pos() const noexcept;
+  std::span<const glm::vec2> vel() const noexcept;
+  std::span<const uint32_t> color() const noexcept;
+  // a host copy for CpuEngine
+  WorldS world() const;
+
+private:
+  const std::byte *data = nullptr;
+  size_t size = 0;
+  const CheckpointHeader *head = nullptr;
+};
+
+// writes count particles into path through a temporary file that is renamed
+// over it once complete, so an interrupted save leaves the old one intact
+void writeCheckpoint(const std::filesystem::path &path, uint64_t step,
+                     std::span<const glm::vec2> pos,
+                     std::span<const glm::vec2> vel,
+                     std::span<const uint32_t> color);
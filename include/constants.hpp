@@ -1,18 +1,75 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 
 namespace world {
 using namespace std::chrono_literals;
 
 using FTime = std::chrono::duration<float, std::chrono::seconds::period>;
+// default length of one simulation step
 constexpr auto delta = FTime(1s) / 120;
-constexpr size_t object_count = 200;
-constexpr float max_x = 100, max_y = 100;
+constexpr uint32_t default_count = 200;
+constexpr float min_extent = 100;
 constexpr float radius = 1.0;
+constexpr uint32_t default_work_size = 256;
+// padding of the verlet kernel's neighbour lists
+constexpr float default_skin = radius / 2;
+
+// the broadphase grid, cells are wide enough that colliding particles are at
+// most one cell apart
+constexpr float cell_size = 2 * radius;
+
+// bits of the key each radix sort pass sorts on and keys each invocation of
+// its count and scatter passes handles, match radix.glsl
+constexpr uint32_t radix_bits = 8;
+constexpr uint32_t radix_items = 8;
+
+// filled in once at startup by configure(), the compute pipelines receive it
+// as specialization constants so its layout has to match compute_spec_map
 struct constants_t {
-  const int obj_count = object_count;
-  const float max_x = world::max_x, max_y = world::max_y;
+  uint32_t obj_count = default_count;
+  float max_x = min_extent, max_y = min_extent;
+  uint32_t grid_w = 1, grid_h = 1;
+  // invocations per workgroup of every compute kernel
+  uint32_t work_size = default_work_size;
+  // a VkBool32, velocities are stored as two halves in one word
+  uint32_t half_velocity = 0;
+  // how much further than touching the neighbour lists reach
+  float skin = default_skin;
+
+  size_t cellCount() const noexcept { return size_t(grid_w) * grid_h; }
+  // workgroups covering every particle once
+  uint32_t groups() const noexcept { return obj_count / work_size + 1; }
+  // workgroups of the radix sort's count and scatter passes, covering
+  // radix_items particles per invocation
+  uint32_t radixTiles() const noexcept {
+    auto tile = work_size * radix_items;
+    return (obj_count + tile - 1) / tile;
+  }
+  // digits counted per radix sort pass, a radix of them per tile
+  uint32_t radixDigits() const noexcept {
+    return (1u << radix_bits) * radixTiles();
+  }
 } inline constants;
 
-} // namespace world
\ No newline at end of file
+// a box of the given size, restored worlds bring their own
+inline void configure(uint32_t count, float max_x, float max_y) {
+  constants.obj_count = count;
+  constants.max_x = max_x;
+  constants.max_y = max_y;
+  constants.grid_w = static_cast<uint32_t>(std::ceil(max_x / cell_size));
+  constants.grid_h = static_cast<uint32_t>(std::ceil(max_y / cell_size));
+}
+
+// sizes the box so the starting lattice spacing never drops below 3 radii,
+// which keeps the grid at a couple of cells per particle at any count
+inline void configure(uint32_t count) {
+  auto extent = std::max(min_extent, 3 * radius * std::sqrt(float(count)));
+  configure(count, extent, extent);
+}
+
+} // namespace world
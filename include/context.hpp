@@ -1,8 +1,11 @@
 #pragma once
 
+#include <optional>
 #include <span>
 #include <vulkan/vulkan.hpp>
 
+#include "allocator.hpp"
+#include "kernel.hpp"
 #include "queues.hpp"
 #include "util/scope_guard.hpp"
 #include "util/vkassert.hpp"
@@ -10,20 +13,33 @@
 
 struct Indicies {
   int graphics = -1, transfer = -1, present = -1, compute = -1;
-  bool isComplete() const noexcept {
-    return graphics != -1 || transfer != -1 || present != -1 || compute != -1;
+  // without a surface there is nothing to present to or draw on, the
+  // compute family stands in for graphics
+  bool isComplete(bool headless = false) const noexcept {
+    return transfer != -1 && compute != -1 &&
+           (headless || (graphics != -1 && present != -1));
   }
 };
 
 constexpr size_t frames_in_flight = 2;
 
+// picks the Context constructor without a window, surface or swapchain
+struct Headless {
+  // off turns the validation layers off even in builds that have them
+  bool validation = true;
+};
+
 struct Context {
   explicit Context(Window &&);
+  explicit Context(Headless);
   ~Context();
 
   void recreateSwapchain();
+  bool headless() const noexcept { return !window; }
 
-  Window window;
+  std::optional<Window> window;
+  // whether the validation layers are on
+  bool validation;
 
   vk::Instance instance;
   vk::DebugUtilsMessengerEXT debug_messager;
@@ -37,10 +53,23 @@ struct Context {
   vk::Format format;
   Indicies indicies;
   vk::PhysicalDevice phys;
+  // the optional features setupDevice managed to enable
+  vk::PhysicalDeviceFeatures features;
+  // every pipeline goes through it, loaded at startup and saved on exit
+  vk::PipelineCache pipeline_cache;
+  // device memory for every Buffer, outlives all of them
+  std::optional<Allocator> allocator;
+};
+
+// the three passes of scan.glsl specialized to scanning count values, see
+// dispatchScan in simulation.cpp
+struct ScanPipes {
+  vk::Pipeline reduce, blocks, add;
+  uint32_t count = 0;
 };
 
 struct Renderer {
-  Renderer(Context &);
+  Renderer(Context &, Kernel = Kernel::grid, Sprite = Sprite::circle);
   void recreateFramebuffers(Context &);
   void execute_immediately(auto &&F) {
     auto cmd = device.allocateCommandBuffers(
@@ -62,6 +91,8 @@ struct Renderer {
   std::vector<vk::CommandBuffer>
   getCommands(uint32_t number,
               vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
+  // primary buffers for the compute queue
+  std::vector<vk::CommandBuffer> getComputeCommands(uint32_t number);
 
   inline std::vector<vk::DescriptorSet>
   getDescriptors(uint32_t number, vk::DescriptorSetLayout layout) const {
@@ -74,20 +105,66 @@ struct Renderer {
 
   vk::Device device;
   Queues queues;
+  Indicies families;
   vk::RenderPass pass;
   std::vector<vk::Framebuffer> framebuffers;
   vk::DescriptorSetLayout descriptor_layout;
   vk::PipelineLayout layout;
   vk::Pipeline graphics_pipe;
+  // compacts the particles in view before the render pass, on display sets
+  vk::PipelineLayout cull_layout;
+  vk::Pipeline cull_pipe;
+  // bins the particles into display's density grid and draws it in their
+  // place once they're too small to make out
+  vk::PipelineLayout splat_layout;
+  vk::Pipeline splat_pipe;
+  vk::Pipeline splat_graphics_pipe;
   vk::DescriptorSetLayout compute_desc_layout;
   vk::PipelineLayout compute_layout;
   vk::Pipeline compute_pipe;
+  vk::Pipeline reduce_pipe;
+  vk::Pipeline reduce_final_pipe;
+  Kernel kernel;
+  Sprite sprite;
+  vk::PipelineCache pipeline_cache;
+  // spent creating the pipelines above, shows what the pipeline cache saves
+  double pipeline_ms = 0;
+  // prefix sums with the world as set 0 and the scanned buffers as set 1,
+  // the push constants match compute_layout's so the world stays bound
+  vk::DescriptorSetLayout scan_desc_layout;
+  vk::PipelineLayout scan_layout;
+  vk::Pipeline grid_count_pipe;
+  // over the cells' counts
+  ScanPipes grid_scan;
+  vk::Pipeline grid_scatter_pipe;
+  vk::Pipeline grid_collide_pipe;
+  // sorts the particles along a z-order curve through the grid's cells every
+  // so often, with the world as set 0 and the sort's buffers as set 1
+  vk::DescriptorSetLayout reorder_desc_layout;
+  vk::PipelineLayout reorder_layout;
+  vk::Pipeline morton_pipe;
+  vk::Pipeline radix_count_pipe;
+  // over the digit histogram, in place
+  ScanPipes radix_scan;
+  vk::Pipeline radix_scatter_pipe;
+  vk::Pipeline reorder_gather_pipe;
+  // the verlet kernel, with the world as set 0 and the neighbour lists as
+  // set 1. only built for that kernel
+  vk::DescriptorSetLayout verlet_desc_layout;
+  vk::PipelineLayout verlet_layout;
+  vk::Pipeline verlet_check_pipe;
+  vk::Pipeline verlet_build_pipe;
+  vk::Pipeline verlet_collide_pipe;
   vk::CommandPool cmd_pool;
+  vk::CommandPool compute_pool;
   vk::DescriptorPool desc_pool;
 
   std::array<vk::Semaphore, frames_in_flight> image_available_sem,
       render_done_sem;
   std::array<vk::Fence, frames_in_flight> inflight_fen;
+  // frame n's simulation signals sim_timeline with n + 1 and its render pass
+  // signals draw_timeline with n + 1
+  vk::Semaphore sim_timeline, draw_timeline;
 
   vk::Extent2D swapchain_extent;
 };
@@ -95,5 +172,27 @@ struct Renderer {
 namespace shaders {
 std::span<const uint32_t> vertex();
 std::span<const uint32_t> fragment();
+std::span<const uint32_t> circleVertex();
+std::span<const uint32_t> circleFragment();
 std::span<const uint32_t> compute();
+std::span<const uint32_t> cull();
+std::span<const uint32_t> splat();
+std::span<const uint32_t> fullscreen();
+std::span<const uint32_t> splatFragment();
+std::span<const uint32_t> tiled();
+std::span<const uint32_t> reduce();
+std::span<const uint32_t> reduceFinal();
+std::span<const uint32_t> scanReduce();
+std::span<const uint32_t> scanBlocks();
+std::span<const uint32_t> scanAdd();
+std::span<const uint32_t> gridCount();
+std::span<const uint32_t> gridScatter();
+std::span<const uint32_t> gridCollide();
+std::span<const uint32_t> morton();
+std::span<const uint32_t> radixCount();
+std::span<const uint32_t> radixScatter();
+std::span<const uint32_t> reorderGather();
+std::span<const uint32_t> verletCheck();
+std::span<const uint32_t> verletBuild();
+std::span<const uint32_t> verletCollide();
 } // namespace shaders
\ No newline at end of file
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/vec4.hpp>
+#include <string_view>
+#include <vector>
+
+#include "thread_pool.hpp"
+#include "ubo.hpp"
+#include "world.hpp"
+
+// the compute shaders' physics on the host for machines without a usable
+// gpu: the same collision response, bounds and red flash, with the grid
+// kernel's cell list as the neighbour search. the state is re-sorted by cell
+// every step so a particle's neighbours are three contiguous runs, one per
+// row of cells, which the collision kernel walks with avx2 or avx-512
+class CpuEngine {
+public:
+  // threads as in ThreadPool, uses world::constants
+  explicit CpuEngine(const WorldS &start, unsigned threads = 0);
+
+  void step(float dt);
+  // what the gpu reduction would report, collisions are counted since the
+  // previous call
+  Observables observe();
+  // the current state in the particle order it started in
+  WorldS world() const;
+
+  unsigned threads() const noexcept { return pool.size(); }
+  // instruction set the collision kernel picked at startup
+  std::string_view isa() const noexcept { return kernel.isa; }
+
+  // the arrays the collision kernel reads
+  struct Particles {
+    const float *x, *y, *vx, *vy;
+  };
+  // a run of neighbour candidates, [begin, end) in sorted order
+  struct Run {
+    uint32_t begin, end;
+  };
+  // adds the response of particle self to every particle of the three runs
+  // onto dv like world.glsl's collide, returns whether any touched it
+  using CollideFn = bool (*)(Particles, const Run *runs, uint32_t self,
+                             float dv[2]);
+  struct Kernel {
+    CollideFn collide;
+    std::string_view isa;
+    // particles tested per instruction
+    float lanes;
+  };
+  // the engine's own cell list, coarser than the gpu's for the wider kernels
+  struct Grid {
+    float cell_size;
+    uint32_t w, h;
+  };
+
+private:
+  struct State {
+    std::vector<float> x, y, vx, vy;
+    std::vector<glm::vec4> color;
+    // index of the particle in the starting state
+    std::vector<uint32_t> id;
+
+    void resize(size_t count);
+    void copy(size_t from, State &to, size_t at) const;
+  };
+  // collision counter owned by one thread, a cache line each
+  struct alignas(64) Counter {
+    uint64_t collisions = 0;
+  };
+
+  // counting sorts current into sorted by cell and fills cell_start
+  void bin();
+
+  State current, sorted;
+  Grid grid;
+  std::vector<uint32_t> cell_of, cell_start, cursor;
+  ThreadPool pool;
+  std::vector<Counter> counters;
+  Kernel kernel;
+};
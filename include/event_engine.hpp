@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <vector>
+
+#include "ubo.hpp"
+#include "world.hpp"
+
+// the same elastic hard spheres as the compute shaders, but moved from one
+// exactly predicted event to the next instead of in fixed steps, which never
+// tunnels and spends nothing on particles flying freely. that wins for dilute
+// gases, where collisions are rare next to steps. every particle keeps its
+// own clock and only moves when an event involves it. the events wait in a
+// binary heap, and a cell list at least a diameter wide keeps predictions to
+// the 3x3 cells around a particle, crossing into the next cell being an
+// event of its own
+class EventEngine {
+public:
+  // uses world::constants for the box, particles starting in a wall are
+  // pushed out of it
+  explicit EventEngine(const WorldS &start);
+
+  // processes every event in the next seconds and moves the clock there
+  void advance(double seconds);
+  // what the gpu reduction would report, collisions count both particles
+  // and are counted since the previous call
+  Observables observe();
+  // the state at the current time in the particle order it started in, with
+  // the red flash of the last collision
+  WorldS world() const;
+
+  double time() const noexcept { return now; }
+
+  struct Stats {
+    uint64_t collisions = 0, bounces = 0, crossings = 0;
+    // events dropped because a collision or bounce had changed the course
+    // they were predicted for
+    uint64_t stale = 0;
+  };
+  const Stats &stats() const noexcept { return counts; }
+
+private:
+  struct Particle {
+    glm::dvec2 pos, vel;
+    // the time pos is at
+    double time = 0;
+    // bumped whenever vel changes, which turns the particle's queued events
+    // stale
+    uint32_t version = 0;
+    uint32_t cell;
+    // neighbours in the cell's list
+    uint32_t prev, next;
+    // of the last collision, negative before the first
+    double hit = -1;
+  };
+  struct Event {
+    enum class Kind : uint8_t { collision, bounce, crossing };
+    double time;
+    Kind kind;
+    // b is the other particle of a collision, the axis of a bounce and the
+    // cell a crossing enters
+    uint32_t a, b;
+    uint32_t version_a, version_b;
+  };
+
+  void link(uint32_t i, uint32_t cell);
+  void unlink(uint32_t i);
+  static void moveTo(Particle &p, double time);
+  void push(const Event &event);
+  bool stale(const Event &event) const;
+  // drops the stale events once they outnumber the live ones by far
+  void compact();
+
+  // queues i's collisions with the particles of the cells in [x0, x1] by
+  // [y0, y1], clamped to the grid. i has to be at the current time
+  void predictCells(uint32_t i, int x0, int x1, int y0, int y1);
+  // every event of i, after its course changed
+  void predict(uint32_t i);
+  void predictBounce(uint32_t i);
+  void predictCrossing(uint32_t i);
+
+  void collide(const Event &event);
+  void bounce(const Event &event);
+  void cross(const Event &event);
+
+  std::vector<Particle> particles;
+  // packed like WorldS, the red channel is replaced while a particle flashes
+  std::vector<uint32_t> color;
+  // first particle of every cell, cells are cell_size wide and tile the box
+  std::vector<uint32_t> head;
+  uint32_t grid_w, grid_h;
+  glm::dvec2 cell_size;
+  std::vector<Event> queue;
+  double now = 0;
+  Stats counts;
+  // collisions at the last observe
+  uint64_t observed = 0;
+};
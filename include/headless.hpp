@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "checkpoint.hpp"
+#include "context.hpp"
+#include "options.hpp"
+#include "recorder.hpp"
+#include "simulation.hpp"
+#include "staging.hpp"
+
+struct GpuRun {
+  uint64_t steps;
+  // wall clock from the first submission until the last batch finished
+  double seconds;
+  // summed between the timestamps around each batch, empty when the compute
+  // queue can't write timestamps
+  std::optional<double> gpu_seconds;
+};
+
+// steps sim steps times on the compute queue, batch_size steps per
+// submission, and reduces the result into sim.observables[0]. every batch
+// waits for what was uploaded through staging before it and captures into
+// recorder if there is one. returns once the gpu is done
+GpuRun stepGpu(Context &context, Renderer &vk, Simulation &sim,
+               StagingRing &staging, uint64_t steps, uint32_t batch_size,
+               float dt, Recorder *recorder = nullptr);
+
+// steps a new world of the current world::constants with kernel for about
+// seconds of wall clock after one warmup batch, which builds the pipelines'
+// caches and sizes the real run
+GpuRun measureGpu(Context &context, const Options &options, Kernel kernel,
+                  double seconds);
+
+// runs options.steps steps on a Context without a window, starting from
+// restore if there is one, and prints how fast they went. returns the exit
+// code
+int runHeadless(const Options &options, const Checkpoint *restore = nullptr);
+
+// the same on CpuEngine with options.threads threads, needs no vulkan at all
+int runCpu(const Options &options, const Checkpoint *restore = nullptr);
+
+// the simulated time of options.steps steps on EventEngine, reported as if it
+// had taken that many steps
+int runEvents(const Options &options, const Checkpoint *restore = nullptr);
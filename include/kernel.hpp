@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// how the compute pass finds colliding pairs
+enum class Kernel {
+  // every particle against every other particle
+  all_pairs,
+  // all pairs, with the other particles staged through shared memory
+  tiled,
+  // uniform cell list rebuilt every step, only neighbouring cells are tested
+  grid,
+  // per particle neighbour lists out of the cell list, padded by a skin so
+  // they're only rebuilt once something has moved half of it
+  verlet,
+};
+
+constexpr std::array kernel_names = {
+    std::string_view("naive"), std::string_view("tiled"),
+    std::string_view("grid"), std::string_view("verlet")};
+
+constexpr std::string_view name(Kernel k) {
+  return kernel_names[static_cast<size_t>(k)];
+}
+
+constexpr std::optional<Kernel> parseKernel(std::string_view name) {
+  for (size_t i = 0; i < kernel_names.size(); i++) {
+    if (kernel_names[i] == name)
+      return static_cast<Kernel>(i);
+  }
+  return std::nullopt;
+}
+
+// whether the kernel tests every pair, count squared tests a step
+constexpr bool allPairs(Kernel k) {
+  return k == Kernel::all_pairs || k == Kernel::tiled;
+}
+
+// the all pairs kernels are left out of sweeps past this. it's already 10^10
+// pair tests a step, tens of milliseconds even on a fast gpu where the grid
+// takes well under one, so they can't win and only stretch the sweep
+constexpr uint32_t max_all_pairs = 100000;
+
+// what runs the simulation
+enum class Engine {
+  // the compute kernels above
+  gpu,
+  // CpuEngine, always headless
+  cpu,
+  // EventEngine, for dilute gases. it fills the world the window draws
+  // every frame, or runs headless
+  events,
+};
+
+constexpr std::array engine_names = {std::string_view("gpu"),
+                                     std::string_view("cpu"),
+                                     std::string_view("events")};
+
+constexpr std::string_view name(Engine e) {
+  return engine_names[static_cast<size_t>(e)];
+}
+
+constexpr std::optional<Engine> parseEngine(std::string_view name) {
+  for (size_t i = 0; i < engine_names.size(); i++) {
+    if (engine_names[i] == name)
+      return static_cast<Engine>(i);
+  }
+  return std::nullopt;
+}
+
+// what the render pass draws every particle as
+enum class Sprite {
+  // an indexed 50 vertex fan out of the mesh buffers
+  mesh,
+  // one triangle whose fragments are cut to the circle, no vertex buffers
+  circle,
+};
+
+constexpr std::array sprite_names = {std::string_view("mesh"),
+                                     std::string_view("circle")};
+
+constexpr std::string_view name(Sprite s) {
+  return sprite_names[static_cast<size_t>(s)];
+}
+
+constexpr std::optional<Sprite> parseSprite(std::string_view name) {
+  for (size_t i = 0; i < sprite_names.size(); i++) {
+    if (sprite_names[i] == name)
+      return static_cast<Sprite>(i);
+  }
+  return std::nullopt;
+}
+
+// whether the kernel and workgroup size are measured at startup
+enum class Tune {
+  // whatever the options say
+  off,
+  // the winner saved for this device and world, measured if there is none
+  cached,
+  // measured even if a winner was saved
+  again,
+};
+
+constexpr std::array tune_names = {std::string_view("off"),
+                                   std::string_view("cached"),
+                                   std::string_view("again")};
+
+constexpr std::string_view name(Tune t) {
+  return tune_names[static_cast<size_t>(t)];
+}
+
+constexpr std::optional<Tune> parseTune(std::string_view name) {
+  for (size_t i = 0; i < tune_names.size(); i++) {
+    if (tune_names[i] == name)
+      return static_cast<Tune>(i);
+  }
+  return std::nullopt;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "constants.hpp"
+#include "kernel.hpp"
+
+// settings picked on the command line, see Options::parse for the flags
+struct Options {
+  uint32_t count = world::default_count;
+  Kernel kernel = Kernel::grid;
+  Sprite sprite = Sprite::circle;
+  // particles narrower than this many pixels are drawn as a density field
+  // instead, 0 always draws them one by one
+  float splat_below = 1.5;
+  Engine engine = Engine::gpu;
+  // invocations per workgroup of the compute kernels
+  uint32_t work_size = world::default_work_size;
+  // picks kernel and work_size by timing them on the device, unless they
+  // were given on the command line. the candidates are kernels and
+  // work_sizes below
+  Tune tune = Tune::cached;
+  bool kernel_given = false, work_size_given = false;
+  // how much further than touching the verlet kernel's neighbour lists
+  // reach, at most world::radius
+  float skin = world::default_skin;
+  // store velocities as halves, which shrinks the state a step moves to half
+  bool half_velocity = false;
+  // worker threads of the cpu engine, 0 uses every hardware thread
+  unsigned threads = 0;
+  // simulated seconds per step
+  float timestep = world::delta.count();
+  // simulated seconds per wall clock second
+  float speed = 1;
+  // most steps recorded into one frame before the simulation falls behind,
+  // headless records exactly this many per submission
+  uint32_t max_substeps = 16;
+  // steps between sorting the particles along a z-order curve so neighbours
+  // sit close in memory, 0 never does
+  uint32_t reorder_every = 0;
+  // run steps steps without a window as fast as possible and print the
+  // throughput
+  bool headless = false;
+  uint64_t steps = 10000;
+  // adds shader invocation counts to the gpu profiler
+  bool pipeline_statistics = false;
+  // checkpoint to start from instead of a new world, its count and box win
+  // over count
+  std::string restore;
+  // checkpoint written when the run ends
+  std::string save;
+  // trajectory file every record_every-th step is written to, quantized to
+  // multiples of record_quantum
+  std::string record;
+  uint32_t record_every = 10;
+  float record_quantum = 1.0f / 1024;
+  // trajectory to play back instead of simulating, its count and box win
+  // over count
+  std::string replay;
+  // sweep every combination of the lists below headless and write the
+  // results to output.csv and output.json
+  bool bench = false;
+  std::string output = "bench";
+  std::vector<uint32_t> counts = {1000, 10000, 100000, 1000000, 10000000};
+  std::vector<Kernel> kernels = {Kernel::all_pairs, Kernel::tiled,
+                                 Kernel::grid, Kernel::verlet};
+  std::vector<uint32_t> work_sizes = {64, 128, 256, 512};
+
+  static Options parse(int argc, char **argv);
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <filesystem>
+#include <string_view>
+#include <vulkan/vulkan.hpp>
+
+// stem-<device uuid>.extension under $XDG_CACHE_HOME/partsim or
+// ~/.cache/partsim, empty if neither is set
+std::filesystem::path deviceCachePath(vk::PhysicalDevice phys,
+                                      std::string_view stem,
+                                      std::string_view extension);
+
+// where phys's pipeline cache lives
+std::filesystem::path pipelineCachePath(vk::PhysicalDevice phys);
+
+// a pipeline cache seeded from the file written by savePipelineCache, or an
+// empty one if there is no file or it was written for another device or
+// driver
+vk::PipelineCache loadPipelineCache(vk::Device device,
+                                    vk::PhysicalDevice phys);
+
+// writes everything cache has accumulated back to disk, failures are only
+// reported since the cache is just an optimization
+void savePipelineCache(vk::Device device, vk::PhysicalDevice phys,
+                       vk::PipelineCache cache);
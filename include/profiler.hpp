@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vulkan/vulkan.hpp>
+
+#include "context.hpp"
+
+// gpu timings of every pass of a frame, written into per frame in flight
+// query pools and read back when the frame's slot comes around again, by
+// which point draw has already waited for it so nothing stalls
+class Profiler {
+public:
+  // marks recorded on the compute queue, a pass runs from its mark to the
+  // next one
+  enum Compute : uint32_t { steps, reduce, compute_end };
+  // marks recorded on the graphics queue
+  enum Graphics : uint32_t { cull, particles, gui, graphics_end };
+
+  Profiler(Context &context, Renderer &vk, bool statistics);
+  ~Profiler();
+  Profiler(const Profiler &) = delete;
+  Profiler &operator=(const Profiler &) = delete;
+
+  // resets slot's queries, before any other recording of the frame on either
+  // queue and outside of a render pass
+  void beginCompute(vk::CommandBuffer buffer, uint32_t slot);
+  void beginGraphics(vk::CommandBuffer buffer, uint32_t slot);
+  // timestamps the start of at's pass, which is also the end of the one
+  // before it
+  void mark(vk::CommandBuffer buffer, uint32_t slot, Compute at);
+  void mark(vk::CommandBuffer buffer, uint32_t slot, Graphics at);
+  // pipeline statistics of whatever is recorded in between, a no-op unless
+  // they were asked for and the device has them
+  void beginStatistics(vk::CommandBuffer buffer, uint32_t slot, bool compute);
+  void endStatistics(vk::CommandBuffer buffer, uint32_t slot, bool compute);
+
+  // folds slot's results into the history, only once the slot's fence and
+  // simulation are known to be done
+  void collect(uint32_t slot);
+  // a collapsing header with graphs and percentiles of every pass
+  void show();
+
+private:
+  static constexpr size_t history = 240;
+  static constexpr size_t pass_count = compute_end + graphics_end;
+  // one per pass in frames, newest at head - 1
+  struct Series {
+    std::array<float, history> ms{};
+  };
+
+  struct Pool {
+    vk::QueryPool pool{};
+    uint32_t per_slot = 0;
+    // ticks before the counter wraps, 0 means the queue has no timestamps
+    uint64_t mask = 0;
+  };
+
+  void read(Pool &pool, uint32_t slot, size_t first_pass);
+
+  vk::Device device;
+  float period;
+  Pool compute_time, graphics_time;
+  Pool compute_stats, graphics_stats;
+  // whether the slot has been recorded since it was last collected
+  std::array<bool, frames_in_flight> pending{};
+
+  std::array<Series, pass_count> passes;
+  size_t head = 0, filled = 0;
+  // latest compute shader, vertex shader, clipped primitive and fragment
+  // shader invocations
+  std::optional<std::array<uint64_t, 4>> statistics;
+};
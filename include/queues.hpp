@@ -4,11 +4,15 @@
 class Queues {
   vk::Queue graphics_q;
   vk::Queue transfer_q;
+  vk::Queue compute_q;
 
 public:
-  Queues() : graphics_q{nullptr}, transfer_q{nullptr} {}
+  Queues() : graphics_q{nullptr}, transfer_q{nullptr}, compute_q{nullptr} {}
   void set_graphics(vk::Queue &&rhs) { graphics_q = rhs; }
   void set_transfer(vk::Queue &&rhs) { transfer_q = rhs; }
+  void set_compute(vk::Queue &&rhs) { compute_q = rhs; }
   auto &render() { return graphics_q; }
   auto &mem() { return transfer_q; }
+  // the simulation queue, may be the same queue as render()
+  auto &compute() { return compute_q; }
 };
\ No newline at end of file
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "buffer.hpp"
+#include "context.hpp"
+#include "simulation.hpp"
+#include "trajectory.hpp"
+
+// writes every every-th step of the simulation to a trajectory file. the
+// compute queue copies positions and velocities into one of a few host
+// buffers and a writer thread encodes and writes them once sim_timeline says
+// the copy is done, so neither the simulation nor the host loop ever waits
+// on the disk. when the writer falls behind and every buffer is still
+// waiting to be written, captures are dropped instead
+class Recorder {
+public:
+  static constexpr uint32_t default_slots = 4;
+
+  // throws if path can't be created
+  Recorder(Context &context, Renderer &vk, const std::filesystem::path &path,
+           uint32_t every, float quantum, float timestep,
+           uint32_t slot_count = default_slots);
+  // writes whatever was submitted and closes the file, the submissions
+  // have to be on their way to signaling sim_timeline
+  ~Recorder();
+  Recorder(const Recorder &) = delete;
+  Recorder &operator=(const Recorder &) = delete;
+
+  uint32_t every() const noexcept { return header.every; }
+
+  // copies the world sim.parity points at into a free buffer, expects the
+  // steps before it to be recorded already. returns false if nothing was
+  // captured, either because the step was captured already or no buffer was
+  // free
+  bool capture(vk::CommandBuffer buffer, Simulation &sim);
+  // the captures since the last call are in the submission signaling value
+  // on sim_timeline
+  void submitted(uint64_t value);
+  // blocks until everything submitted so far is written
+  void drain();
+
+  // frames written and dropped, bytes the frames would have taken as floats
+  // and what was actually written
+  struct Stats {
+    uint64_t frames = 0, dropped = 0, raw = 0, written = 0;
+  };
+  Stats stats() const noexcept;
+  // a collapsing header with the stats
+  void show();
+
+private:
+  struct Slot {
+    Buffer buffer;
+    uint64_t step = 0;
+    // whether the world was reordered and the particle ids were copied too
+    bool permuted = false;
+    // whether the velocities were copied as halves
+    bool half_velocity = false;
+    // sim_timeline value after which the copy can be read
+    uint64_t value = 0;
+  };
+
+  void run();
+
+  vk::Device device;
+  vk::Semaphore timeline;
+  TrajectoryHeader header;
+  std::FILE *file;
+  std::vector<Slot> slots;
+  // step of the last capture, so a step isn't captured twice
+  uint64_t last = UINT64_MAX;
+  // captured but not submitted yet, only touched by the host loop
+  std::vector<uint32_t> pending;
+
+  std::mutex mutex;
+  std::condition_variable ready, idle;
+  // slots free to capture into and ones waiting for the writer
+  std::vector<uint32_t> spare;
+  std::deque<uint32_t> queue;
+  bool stopping = false;
+  // why writing stopped, empty while it hasn't
+  std::string error;
+
+  std::atomic<uint64_t> frames = 0, dropped = 0, raw = 0, written = 0;
+  std::thread writer;
+};
+
+// records steps like recordSteps does, capturing into recorder every time
+// sim.step reaches a multiple of recorder.every() including before the first
+// step
+void recordSteps(Renderer &c, vk::CommandBuffer buffer, Simulation &sim,
+                 unsigned steps, float dt, Recorder &recorder);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <glm/vec2.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulation.hpp"
+#include "staging.hpp"
+#include "trajectory.hpp"
+
+// plays a trajectory file back in place of the simulation. the file is
+// mapped rather than read, so it can be larger than memory, and a worker
+// thread decodes the frames ahead of the playhead while the kernel is told
+// to read the ones after that in. the host loop only ever copies decoded
+// frames into the staging ring
+class Replay {
+public:
+  // decoded frames kept ahead of the playhead
+  static constexpr size_t prefetch = 4;
+
+  // throws if the file can't be mapped or isn't a trajectory of this
+  // version. a frame cut off at the end, like a crashed recording leaves
+  // behind, is ignored
+  explicit Replay(const std::filesystem::path &path);
+  ~Replay();
+  Replay(const Replay &) = delete;
+  Replay &operator=(const Replay &) = delete;
+
+  const TrajectoryHeader &header() const noexcept { return *head; }
+  size_t frames() const noexcept { return index.size(); }
+
+  // moves the playhead by seconds of wall clock at speed, stopping at the
+  // last frame
+  void advance(double seconds);
+  // uploads the frame under the playhead into the world buffer sim isn't
+  // on and points sim.parity at it, if the frame is decoded already and
+  // isn't there yet. returns whether it uploaded. whatever last read that
+  // world has to be done
+  bool upload(StagingRing &staging, Simulation &sim);
+  // a collapsing header with the playback controls
+  void show();
+
+  // simulated seconds per wall clock second
+  float speed = 1;
+  bool paused = false;
+
+private:
+  struct Entry {
+    uint64_t step;
+    // of the payload, the frame header is right before it
+    uint64_t offset;
+    uint32_t bytes;
+    bool keyframe;
+  };
+  struct Decoded {
+    size_t frame = 0;
+    std::vector<glm::vec2> pos, vel;
+  };
+
+  // the last frame recorded at or before step
+  size_t frameAt(double step) const;
+  size_t keyframeBefore(size_t frame) const;
+  // whether the worker has something to do, with mutex held
+  bool busy() const;
+  void run();
+
+  const std::byte *data = nullptr;
+  size_t size = 0;
+  const TrajectoryHeader *head = nullptr;
+  std::vector<Entry> index;
+  // in steps
+  double playhead = 0;
+  size_t shown = SIZE_MAX;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  // the frame the playhead is on and the next one the worker decodes
+  size_t want = 0, next = 0;
+  // decoded frames in order without gaps. the host loop reads the one for
+  // want outside the lock, the worker drops any frame but that one
+  std::deque<Decoded> ready;
+  std::vector<Decoded> spare;
+  bool stopping = false;
+  // why decoding stopped, empty while it hasn't
+  std::string error;
+  std::thread worker;
+};
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "buffer.hpp"
+#include "checkpoint.hpp"
+#include "context.hpp"
+#include "staging.hpp"
+#include "ubo.hpp"
+#include "world.hpp"
+
+// a scan's block sums and the set binding them with its input and output,
+// see dispatchScan in simulation.cpp
+struct ScanBuffers {
+  Buffer sums;
+  vk::DescriptorSet desc;
+};
+
+struct GridBuffers {
+  Buffer counts, starts, items;
+  // from the counts into the starts
+  ScanBuffers scan;
+};
+
+// the morton reordering's buffers, see recordReorder
+struct ReorderBuffers {
+  // steps between reorders
+  uint32_t every;
+  // the sort's keys and the slots they came from, each pass reads one of
+  // the pair and writes the other
+  std::array<Buffer, 2> keys, values;
+  // the keys per digit per tile, scanned in place
+  Buffer histogram;
+  ScanBuffers scan;
+  // the particle in each slot, so a particle can be followed however often
+  // it moved, and the gather's output before it's copied over
+  Buffer ids, ids_next;
+  // set p reads keys[p] and values[p]
+  std::array<vk::DescriptorSet, 2> descs{};
+};
+
+// the verlet kernel's buffers, see dispatchVerlet in simulation.cpp
+struct VerletBuffers {
+  // max_neighbours slots per particle, how many are used and where the
+  // particle was when they were filled
+  Buffer lists, counts, origins;
+  // one VerletState, also read as the build's indirect dispatches
+  Buffer state;
+  vk::DescriptorSet desc;
+};
+
+// everything the compute queue owns, the world buffers are only ever touched
+// by the simulation so they're shared with the setup queues instead of
+// changing hands
+struct Simulation {
+  WorldLayout layout;
+  std::array<Buffer, 2> world;
+  Buffer reduction;
+  MappedBuffer<Observables> observables;
+  GridBuffers grid;
+  // only when the particles are reordered
+  std::optional<ReorderBuffers> reorder;
+  // only for the verlet kernel
+  std::optional<VerletBuffers> verlet;
+  std::array<vk::DescriptorSet, 2> descs{};
+  int parity = 0;
+  // steps recorded so far, including the ones a restored checkpoint had
+  uint64_t step = 0;
+};
+
+// execution and memory dependency from the writes of src to the shader and,
+// if dst includes it, transfer accesses of dst
+void computeBarrier(vk::CommandBuffer buffer, vk::PipelineStageFlags dst,
+                    vk::PipelineStageFlags src =
+                        vk::PipelineStageFlagBits::eComputeShader);
+
+// hands target from one queue family to another. both families record the
+// same barrier, the releasing side before the semaphore signal and the
+// acquiring side after the wait. nothing is needed when the families match
+void ownershipBarrier(vk::CommandBuffer buffer, vk::Buffer target,
+                      uint32_t from, uint32_t to, vk::PipelineStageFlags src,
+                      vk::AccessFlags src_access, vk::PipelineStageFlags dst,
+                      vk::AccessFlags dst_access);
+
+// the queue families that touch the simulation's buffers, the setup queues
+// upload and clear them and the compute queue steps them
+std::vector<uint32_t> simulationFamilies(Context &vk);
+
+// allocates the simulation's buffers and fills the world through staging
+// with restore's arrays, or genWorld without one. reorder_every steps the
+// particles are sorted along a z-order curve, never if it's 0. the first
+// step has to wait on staging's timeline
+Simulation createSimulation(Context &context, Renderer &vk,
+                            StagingRing &staging,
+                            const Checkpoint *restore = nullptr,
+                            uint32_t reorder_every = 0);
+
+// uploads vel into the velocities of buffer, a world with layout, as halves
+// if that's how layout stores them
+void uploadVelocities(StagingRing &staging, vk::Buffer buffer,
+                      const WorldLayout &layout,
+                      std::span<const glm::vec2> vel);
+
+// reads the current world back and writes it to path in particle order,
+// waits for the device to go idle first
+void saveCheckpoint(const std::filesystem::path &path, Context &context,
+                    Renderer &vk, Simulation &sim);
+
+// advances sim.world[sim.parity] by one step of dt seconds into the other
+// world, leaving sim.parity alone
+void recordStep(Renderer &c, vk::CommandBuffer buffer, Simulation &sim,
+                float dt);
+
+// sorts the particles of sim.world[sim.parity] by the morton code of their
+// cell into the other world and points sim.parity at it, so particles close
+// in space are close in memory for the kernels and the vertex shader. the
+// ids follow the particles. expects the writes before it to be made visible
+// and makes its own visible to the compute and transfer stages
+void recordReorder(Renderer &c, vk::CommandBuffer buffer, Simulation &sim);
+
+// records steps steps starting from sim.world[sim.parity] with barriers in
+// between, reordering whenever sim.step reaches a multiple of the reorder
+// interval, leaving sim.parity on the world holding the result. expects the
+// writes before it to already be made visible
+void recordSteps(Renderer &c, vk::CommandBuffer buffer, Simulation &sim,
+                 unsigned steps, float dt);
+
+// reads the verlet kernel's bookkeeping back, waits for the device to go idle
+// first. sim has to have been created for that kernel
+VerletState readVerletState(Context &context, Renderer &vk, Simulation &sim);
+
+// reduces the observables of the world bound as input into slot, which the
+// host can read once the submission has finished
+void recordReduce(Renderer &c, vk::CommandBuffer buffer,
+                  vk::DescriptorSet world, uint32_t slot);
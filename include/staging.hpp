@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <span>
+#include <vulkan/vulkan.hpp>
+
+#include "buffer.hpp"
+#include "context.hpp"
+
+// a persistently mapped host buffer that uploads are copied through on the
+// transfer queue. uploads are batched into one submission per flush, which
+// signals timeline with the value flush returns, and the ring only waits on
+// the host once it has wrapped around onto a batch that is still running
+class StagingRing {
+public:
+  static constexpr vk::DeviceSize default_size = 16 << 20;
+
+  StagingRing(Context &context, Renderer &vk,
+              vk::DeviceSize size = default_size);
+  ~StagingRing();
+  StagingRing(const StagingRing &) = delete;
+  StagingRing &operator=(const StagingRing &) = delete;
+
+  // copies data into the ring and records its copy to dst at offset into the
+  // current batch. dst has to be usable from the transfer queue family,
+  // either because it's the family's or concurrent with it
+  void upload(vk::Buffer dst, std::span<const uint8_t> data,
+              vk::DeviceSize offset = 0);
+  // submits the current batch, returns the timeline value it signals or the
+  // previous batch's if nothing was uploaded since
+  uint64_t flush();
+  // blocks until the batch flush returned value for is done
+  void wait(uint64_t value);
+
+  // queue submissions reading what was uploaded wait on this
+  vk::Semaphore timeline;
+
+private:
+  struct Batch {
+    vk::CommandBuffer cmd;
+    // bytes of the ring it took, including what was skipped at the end to
+    // wrap around
+    vk::DeviceSize bytes = 0;
+    uint64_t value = 0;
+  };
+
+  // a range of size bytes, waits for old batches if the ring is full
+  vk::DeviceSize reserve(vk::DeviceSize size);
+  void retire();
+
+  vk::Device device;
+  vk::Queue queue;
+  vk::CommandPool pool;
+  Buffer ring;
+  uint8_t *mapped;
+  vk::DeviceSize size;
+  // the next byte to write and the first byte still in flight, used tells
+  // them apart when they meet
+  vk::DeviceSize head = 0, tail = 0, used = 0;
+  Batch current;
+  std::deque<Batch> in_flight;
+  std::vector<vk::CommandBuffer> spare;
+  uint64_t submitted = 0;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of workers that split loops between them, the calling thread
+// works on the loop as well so a pool of n threads starts n - 1 workers
+class ThreadPool {
+public:
+  // 0 picks one thread per hardware thread
+  explicit ThreadPool(unsigned threads = 0);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  unsigned size() const noexcept { return workers.size() + 1; }
+
+  // calls body(begin, end, thread) over [0, count) in chunks of at most grain
+  // items, thread is below size() and unique among concurrent calls. returns
+  // once every chunk is done
+  void parallelFor(
+      size_t count, size_t grain,
+      const std::function<void(size_t, size_t, unsigned)> &body);
+
+private:
+  void run(unsigned thread);
+  void work(unsigned thread);
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable start, done;
+  // bumped for every loop, workers sleep until it changes
+  size_t generation = 0;
+  unsigned busy = 0;
+  bool stopping = false;
+
+  // the current loop, only touched by the caller while busy is 0
+  const std::function<void(size_t, size_t, unsigned)> *body = nullptr;
+  size_t count = 0, grain = 1;
+  size_t next = 0;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <span>
+#include <vector>
+
+// a trajectory file is this header followed by frames, each a FrameHeader
+// and its payload. everything is in host byte order
+struct TrajectoryHeader {
+  static constexpr std::array<char, 8> file_magic = {'p', 'a', 'r', 't',
+                                                     's', 'i', 'm', 't'};
+  static constexpr uint32_t current_version = 1;
+
+  std::array<char, 8> magic = file_magic;
+  uint32_t version = current_version;
+  uint32_t count = 0;
+  float max_x = 0, max_y = 0;
+  // simulation steps between recorded frames
+  uint32_t every = 1;
+  // every keyframe_interval-th frame is encoded against zero instead of the
+  // frame before it, which is where decoding can start
+  uint32_t keyframe_interval = 64;
+  // world units per quantization step
+  float pos_quantum = 1.0f / 1024, vel_quantum = 1.0f / 1024;
+  // simulated seconds per step
+  float timestep = 0;
+  uint32_t reserved = 0;
+};
+
+struct FrameHeader {
+  uint64_t step = 0;
+  // payload bytes following the header
+  uint32_t bytes = 0;
+  uint32_t keyframe = 0;
+};
+
+// quantizes each component to a multiple of the header's quantum and stores
+// the difference to the previous frame's quantized value as a zigzag varint,
+// so particles that barely moved take a byte per component. components are
+// stored planar, every x position, then every y and so on
+class FrameEncoder {
+public:
+  explicit FrameEncoder(const TrajectoryHeader &header);
+
+  // replaces out with the payload of the next frame
+  FrameHeader encode(uint64_t step, std::span<const glm::vec2> pos,
+                     std::span<const glm::vec2> vel, std::vector<uint8_t> &out);
+
+private:
+  TrajectoryHeader header;
+  std::vector<int32_t> previous;
+  uint64_t frames = 0;
+};
+
+// the inverse of FrameEncoder, frames have to be fed in file order starting
+// from a keyframe
+class FrameDecoder {
+public:
+  explicit FrameDecoder(const TrajectoryHeader &header);
+
+  // throws if payload is malformed or a delta frame comes without the
+  // frames before it
+  void decode(const FrameHeader &frame, std::span<const uint8_t> payload,
+              std::span<glm::vec2> pos, std::span<glm::vec2> vel);
+  // forgets the previous frame, the next one has to be a keyframe
+  void reset() noexcept { primed = false; }
+
+private:
+  TrajectoryHeader header;
+  std::vector<int32_t> previous;
+  bool primed = false;
+};
@@ -1,9 +1,68 @@
 #pragma once
 
+#include <cstdint>
 #include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 
 // this should be a combination of model view projection
 struct PushConstants {
 	glm::mat4 transform;
+};
+
+// pushed to the culling pass once per frame, transform is the vertex
+// shader's
+struct CullConstants {
+  glm::mat4 transform;
+  // world units from a particle's center its sprite can cover
+  float reach;
+};
+
+// pushed to both splatting passes once per frame, matches splat.glsl
+struct SplatConstants {
+  glm::mat4 transform;
+  // cells of the density grid and pixels of the framebuffer
+  glm::uvec2 grid;
+  glm::vec2 viewport;
+  // fixed point units per unit of kinetic energy, and the energy that's
+  // halfway from cold to hot
+  float energy_scale;
+  float reference;
+};
+
+// pushed to the compute kernels once per step
+struct StepConstants {
+  // simulated seconds the step advances
+  float dt;
+  // frame in flight whose Observables the reduction writes
+  uint32_t slot;
+};
+
+// pushed to each pass of the morton reordering's radix sort
+struct RadixConstants {
+  // of the key digit the pass sorts on
+  uint32_t shift;
+};
+
+// the verlet kernel's bookkeeping on the gpu, matches verlet_state in
+// verlet.glsl
+struct VerletState {
+  // float bits of the furthest a particle got since the lists were built
+  uint32_t max_displacement;
+  // times the lists were built
+  uint32_t builds;
+  // VkDispatchIndirectCommands of the build's passes
+  glm::uvec3 particle_dispatch, scan_dispatch, block_dispatch;
+  // lists that were cut short, summed over every build
+  uint32_t overflows;
+};
+
+// whole-system values reduced on the gpu once per frame, matches the struct
+// in reduce_final.comp
+struct Observables {
+  glm::vec2 momentum;
+  float kinetic;
+  float max_speed;
+  // particles that touched another during the frame's steps
+  uint32_t collisions;
+  uint32_t reserved;
 };
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+#include <unistd.h>
+
+namespace detail {
+// tells apart the temporaries of one process, the pid tells apart processes
+inline std::atomic<uint64_t> replace_counter = 0;
+} // namespace detail
+
+// writes path through write(std::ofstream &) into a temporary next to it and
+// renames that over path, so readers and other processes writing the same
+// file only ever see a whole one. failures are reported as what and leave
+// path as it was, returns whether it was replaced
+template <typename Write>
+bool replaceFile(const std::filesystem::path &path, std::string_view what,
+                 Write &&write) {
+  namespace fs = std::filesystem;
+  std::error_code err;
+  fs::create_directories(path.parent_path(), err);
+  auto temp = path;
+  temp += fmt::format(".{}.{}", ::getpid(), detail::replace_counter++);
+  {
+    auto file = std::ofstream(temp, std::ios::binary);
+    write(file);
+    file.close();
+    if (!file) {
+      fmt::print(stderr, "couldn't write {} {}\n", what, temp.string());
+      fs::remove(temp, err);
+      return false;
+    }
+  }
+  fs::rename(temp, path, err);
+  if (err) {
+    fmt::print(stderr, "couldn't write {} {}: {}\n", what, path.string(),
+               err.message());
+    fs::remove(temp, err);
+    return false;
+  }
+  return true;
+}
@@ -14,6 +14,9 @@ struct ScreenScale {
   float width = 0.0, height = 0.0;
 };
 
+// world units to clip space before the view transform
+inline constexpr ScreenScale screen_scale = {1 / 50.0, 1 / 30.0};
+
 struct Window {
   Window(std::string_view title, Extent size);
   ~Window();
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+// host copy of the simulation state, laid out as arrays like the device copy.
+// colors are rgba8 packed like glsl's packUnorm4x8
+struct WorldS {
+  std::vector<glm::vec2> pos;
+  std::vector<glm::vec2> vel;
+  std::vector<uint32_t> color;
+};
+
+uint32_t packColor(glm::vec4 color);
+glm::vec4 unpackColor(uint32_t color);
+// velocities as two halves in one word like glsl's packHalf2x16, how the
+// device stores them with half_velocity
+std::vector<uint32_t> packVelocities(std::span<const glm::vec2> vel);
+void unpackVelocities(std::span<const uint32_t> packed,
+                      std::span<glm::vec2> vel);
+
+// where each array of a world state lives inside one device buffer, arrays
+// start on 256 bytes since no device asks for a larger storage buffer offset
+// alignment than that. velocities are halves when world::constants says so
+struct WorldLayout {
+  static constexpr vk::DeviceSize alignment = 256;
+
+  size_t count;
+  bool half_velocity;
+  vk::DeviceSize pos, vel, color, size;
+
+  explicit WorldLayout(size_t count);
+
+  // bytes of one particle's velocity and of its whole state, which a step
+  // reads and writes once each
+  vk::DeviceSize velSize() const noexcept;
+  vk::DeviceSize particleSize() const noexcept;
+
+  // pos, vel and color in binding order
+  std::array<vk::DescriptorBufferInfo, 3> describe(vk::Buffer) const;
+};
+
+// lattice of count particles filling the configured box with random
+// velocities, uses world::constants
+WorldS genWorld();
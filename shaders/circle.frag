@@ -0,0 +1,15 @@
+#version 450
+
+layout(location = 0) out vec4 outColor;
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 local;
+
+void main() {
+    // distance to the edge in pixels gives a one pixel wide falloff at any
+    // zoom, blended over whatever was drawn before
+    float dist = length(local);
+    float coverage = clamp(0.5 - (dist - 1.0) / fwidth(dist), 0.0, 1.0);
+    if (coverage == 0.0)
+        discard;
+    outColor = vec4(fragColor, coverage);
+}
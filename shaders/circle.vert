@@ -0,0 +1,45 @@
+#version 450
+
+// one triangle per particle that the unit circle fits inside with room for
+// the antialiased edge, circle.frag cuts the circle out of it
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 local;
+
+layout (constant_id = 0) const float scale_x = 1.0;
+layout (constant_id = 1) const float scale_y = 1.0;
+
+layout(constant_id = 2) const uint count = 4;
+const vec2 scale = vec2(scale_x, scale_y);
+
+layout(binding = 0, std430) readonly buffer pos_in{
+    vec2 pos[];
+};
+// rgba8
+layout(binding = 2, std430) readonly buffer color_in{
+    uint color[];
+};
+// the particles cull.comp found in view, one per instance
+layout(binding = 11, std430) readonly buffer visible_in{
+    uint visible[];
+};
+
+layout( push_constant ) uniform constants {
+    mat4 render_matrix;
+};
+
+// an equilateral triangle's incircle has half the radius of its
+// circumcircle, this one's incircle is a quarter bigger than the particle
+const float margin = 1.25;
+const vec2 corners[3] = vec2[](vec2(0, 2 * margin),
+                               vec2(-sqrt(3.0) * margin, -margin),
+                               vec2(sqrt(3.0) * margin, -margin));
+
+void main() {
+    uint particle = visible[gl_InstanceIndex];
+    local = corners[gl_VertexIndex];
+    // the mesh is placed the same way, see shader.vert
+    gl_Position = render_matrix *
+    vec4(scale * (local - pos[particle]), 0.0, 1.0);
+    fragColor = unpackUnorm4x8(color[particle]).xyz;
+}
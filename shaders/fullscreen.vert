@@ -0,0 +1,8 @@
+#version 450
+
+// one triangle covering the whole viewport
+
+void main() {
+  vec2 corner = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+  gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
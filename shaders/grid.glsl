@@ -0,0 +1,32 @@
+// uniform cell list, cells are 2 * radius wide so any touching pair is at
+// most one cell apart
+
+layout(constant_id = 3) const uint grid_w = 1;
+layout(constant_id = 4) const uint grid_h = 1;
+const uint cells = grid_w * grid_h;
+const float cell_size = 2 * radius;
+
+// particles per cell, the scatter counts them back down to zero as it fills
+// their ranges
+layout(binding = 7, std430) buffer grid_count{
+  uint cell_count[];
+};
+
+// exclusive prefix sum of cell_count, cells + 1 entries
+layout(binding = 8, std430) buffer grid_start{
+  uint cell_start[];
+};
+
+// particle indices sorted by cell
+layout(binding = 9, std430) buffer grid_items{
+  uint cell_items[];
+};
+
+ivec2 cell_coord(vec2 pos) {
+  return clamp(ivec2(floor(pos / cell_size)), ivec2(0),
+               ivec2(grid_w - 1, grid_h - 1));
+}
+
+uint cell_index(ivec2 coord) {
+  return uint(coord.y) * grid_w + uint(coord.x);
+}
@@ -0,0 +1,45 @@
+// shared by the morton reordering passes, pulled in with
+// GL_GOOGLE_include_directive after count and work_size are declared. the
+// keys are sorted least significant digit first, each pass reads the first
+// pair of arrays and writes the second and the host swaps the two sets
+// between passes
+
+// match radix_bits and radix_items in constants.hpp
+const uint radix_bits = 8;
+const uint radix = 1 << radix_bits;
+// keys each invocation of the count and scatter passes handles, in runs of
+// work_size neighbouring keys
+const uint radix_items = 8;
+const uint radix_tile = work_size * radix_items;
+// workgroups of the count and scatter passes, like constants_t::radixTiles()
+const uint tiles = (count + radix_tile - 1) / radix_tile;
+
+layout(set = 1, binding = 0, std430) buffer keys_in{
+  uint key[];
+};
+// the slot each key came from
+layout(set = 1, binding = 1, std430) buffer values_in{
+  uint value[];
+};
+layout(set = 1, binding = 2, std430) writeonly buffer keys_out{
+  uint key_out[];
+};
+layout(set = 1, binding = 3, std430) writeonly buffer values_out{
+  uint value_out[];
+};
+
+// keys per digit per tile, digit major so its exclusive scan, done in place
+// by scan.glsl, is where each tile's run of a digit starts. the scan's total
+// goes after them
+layout(set = 1, binding = 4, std430) buffer radix_histogram{
+  uint digit_offset[];
+};
+
+// which particle sits in each slot, and where the gather writes the next
+// mapping before the host copies it back
+layout(set = 1, binding = 5, std430) readonly buffer particle_ids{
+  uint particle_id[];
+};
+layout(set = 1, binding = 6, std430) writeonly buffer particle_ids_next{
+  uint particle_id_next[];
+};
@@ -0,0 +1,20 @@
+// shared by the radix sort's count and scatter passes, pulled in with
+// GL_GOOGLE_include_directive after radix.glsl. the kernel enables
+// GL_KHR_shader_subgroup_ballot
+
+// the valid invocations of the subgroup whose digit matches this one's, one
+// ballot per bit of the digit. every invocation has to call it
+uvec4 digitPeers(uint digit, bool valid) {
+  uvec4 peers = subgroupBallot(valid);
+  for (uint b = 0; b < radix_bits; b++) {
+    bool set = ((digit >> b) & 1) != 0;
+    uvec4 ballot = subgroupBallot(set);
+    peers &= set ? ballot : ~ballot;
+  }
+  return peers;
+}
+
+// whether this invocation speaks for its peers
+bool leadsPeers(uvec4 peers) {
+  return subgroupBallotFindLSB(peers) == gl_SubgroupInvocationID;
+}
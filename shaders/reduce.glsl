@@ -0,0 +1,36 @@
+// workgroup reduction shared by both passes of the observables reduction,
+// every invocation of the workgroup has to call reduceWorkgroup. the subgroup
+// extension is enabled by world.glsl
+
+shared Partial per_subgroup[work_size];
+
+Partial combine(Partial a, Partial b) {
+  return Partial(a.momentum + b.momentum, a.kinetic + b.kinetic,
+                 max(a.max_speed, b.max_speed));
+}
+
+Partial reduceSubgroup(Partial p) {
+  return Partial(subgroupAdd(p.momentum), subgroupAdd(p.kinetic),
+                 subgroupMax(p.max_speed));
+}
+
+// the result is only complete in the invocation where isWriter() is true
+Partial reduceWorkgroup(Partial p) {
+  p = reduceSubgroup(p);
+  if (subgroupElect()) {
+    per_subgroup[gl_SubgroupID] = p;
+  }
+  barrier();
+
+  Partial total = Partial(vec2(0, 0), 0, 0);
+  if (gl_SubgroupID == 0) {
+    for (uint i = gl_SubgroupInvocationID; i < gl_NumSubgroups;
+         i += gl_SubgroupSize) {
+      total = combine(total, per_subgroup[i]);
+    }
+    total = reduceSubgroup(total);
+  }
+  return total;
+}
+
+bool isWriter() { return gl_SubgroupID == 0 && subgroupElect(); }
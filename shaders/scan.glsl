@@ -0,0 +1,64 @@
+// shared by the scan passes, pulled in with GL_GOOGLE_include_directive. an
+// exclusive prefix sum of scan_count values in three passes: every workgroup
+// sums a tile of them, a single workgroup scans those sums into the tiles'
+// offsets and every workgroup scans its tile again starting at its offset.
+// each pass reads its tile in runs of work_size neighbouring values, so the
+// loads coalesce however many values there are. bound as set 1 next to the
+// world set, so the kernels' sets stay bound around it
+#extension GL_KHR_shader_subgroup_arithmetic : require
+
+layout(local_size_x_id = 5) in;
+const uint work_size = gl_WorkGroupSize.x;
+layout(constant_id = 8) const uint scan_count = 1;
+
+// values each invocation handles per tile, matches scan_items in
+// simulation.cpp and scan_tile in verlet_check.comp
+const uint scan_items = 16;
+const uint scan_tile = work_size * scan_items;
+const uint scan_blocks = (scan_count + scan_tile - 1) / scan_tile;
+
+layout(set = 1, binding = 0, std430) readonly buffer scan_input{
+  uint scan_in[];
+};
+// scan_count + 1 entries, the last being the total. it can be the same
+// buffer as the input, every value is read by the invocation that writes it
+layout(set = 1, binding = 1, std430) writeonly buffer scan_output{
+  uint scan_out[];
+};
+// one per tile, its sum and then its offset
+layout(set = 1, binding = 2, std430) buffer scan_block_sums{
+  uint block_sum[];
+};
+
+shared uint subgroup_sum[work_size];
+shared uint workgroup_sum;
+
+// the sum of v over the invocations before this one in the workgroup and
+// over all of them as total. every invocation has to call it
+uint workgroupExclusiveAdd(uint v, out uint total) {
+  uint inclusive = subgroupInclusiveAdd(v);
+  if (gl_SubgroupInvocationID == subgroupMax(gl_SubgroupInvocationID))
+    subgroup_sum[gl_SubgroupID] = inclusive;
+  barrier();
+  // the first subgroup scans the subgroups' sums, in runs of its own size
+  // since there can be more subgroups than it has invocations
+  if (gl_SubgroupID == 0) {
+    uint carry = 0;
+    for (uint first = 0; first < gl_NumSubgroups; first += gl_SubgroupSize) {
+      uint i = first + gl_SubgroupInvocationID;
+      uint sum = i < gl_NumSubgroups ? subgroup_sum[i] : 0;
+      uint before = subgroupExclusiveAdd(sum);
+      if (i < gl_NumSubgroups)
+        subgroup_sum[i] = carry + before;
+      carry += subgroupAdd(sum);
+    }
+    if (subgroupElect())
+      workgroup_sum = carry;
+  }
+  barrier();
+  uint result = subgroup_sum[gl_SubgroupID] + inclusive - v;
+  total = workgroup_sum;
+  // the next call overwrites both
+  barrier();
+  return result;
+}
@@ -9,13 +9,18 @@ layout (constant_id = 0) const float scale_x = 1.0;
 layout (constant_id = 1) const float scale_y = 1.0;
 
 layout(constant_id = 2) const uint count = 4;
-const uint size = 256 * 20;
 const vec2 scale = vec2(scale_x, scale_y);
 
-layout(binding = 0, std430) buffer worldstate{
-    vec2 pos[size];
-    vec2 vel[size];
-  vec4 color[size];
+layout(binding = 0, std430) readonly buffer pos_in{
+    vec2 pos[];
+};
+// rgba8
+layout(binding = 2, std430) readonly buffer color_in{
+    uint color[];
+};
+// the particles cull.comp found in view, one per instance
+layout(binding = 11, std430) readonly buffer visible_in{
+    uint visible[];
 };
 
 layout( push_constant ) uniform constants {
@@ -23,7 +28,8 @@ layout( push_constant ) uniform constants {
 };
 
 void main() {
+    uint particle = visible[gl_InstanceIndex];
     gl_Position =  render_matrix * 
-    vec4(scale * (inPosition - pos[gl_InstanceIndex]), 0.0, 1.0);
-    fragColor = color[gl_InstanceIndex].xyz;
+    vec4(scale * (inPosition - pos[particle]), 0.0, 1.0);
+    fragColor = unpackUnorm4x8(color[particle]).xyz;
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+// colour maps the density grid, brightness follows how many particles a
+// pixel holds and hue their mean kinetic energy, cold blue to hot red
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 13, std430) readonly buffer density_grid{
+  uint density[];
+};
+
+#include "splat.glsl"
+
+void main() {
+  uvec2 cell = min(uvec2(gl_FragCoord.xy / viewport * vec2(grid)), grid - 1);
+  uint at = 2 * (cell.y * grid.x + cell.x);
+  uint particles = density[at];
+  if (particles == 0) {
+    outColor = vec4(0.0, 0.0, 0.0, 1.0);
+    return;
+  }
+  // a single particle is dim, a couple hundred saturate
+  float brightness = clamp(log2(1.0 + float(particles)) / 8.0, 0.15, 1.0);
+  float energy = float(density[at + 1]) / (energy_scale * float(particles));
+  float heat = energy / (energy + reference);
+  vec3 hue = mix(vec3(0.2, 0.4, 1.0), vec3(1.0, 0.3, 0.1), heat);
+  outColor = vec4(hue * brightness, 1.0);
+}
@@ -0,0 +1,17 @@
+// shared by the density splatting passes, pulled in with
+// GL_GOOGLE_include_directive. the grid itself is binding 13, two counters
+// per cell: the particles that landed on it and their summed kinetic energy
+// in fixed point
+
+layout(push_constant) uniform splat_constants{
+  // the vertex shaders' transform
+  mat4 render_matrix;
+  // cells of the density grid, set when the grid was allocated
+  uvec2 grid;
+  // pixels of the framebuffer drawn into, which can have been resized since
+  vec2 viewport;
+  // fixed point units per unit of kinetic energy
+  float energy_scale;
+  // kinetic energy halfway between cold and hot
+  float reference;
+};
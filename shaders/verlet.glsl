@@ -0,0 +1,45 @@
+// shared by the verlet kernel's passes, pulled in with
+// GL_GOOGLE_include_directive after world.glsl and grid.glsl. every particle
+// lists the others that were within 2 * radius + skin of it when the lists
+// were built, which holds every pair that can touch until one of them has
+// moved skin / 2
+
+// at most radius, the host checks
+layout(constant_id = 7) const float skin = 0.5;
+// partners a list holds, matches max_neighbours in simulation.cpp. with the
+// skin at most a radius fewer than this fit within reach of a particle
+// without overlapping it, but the stepped kernels leave overlaps behind in
+// crowded spots. a list that would overflow is cut short, which drops
+// partners in cell order and can leave a pair listed on one side only, so
+// the build counts it and has the next step build again
+const uint max_neighbours = 16;
+
+layout(set = 1, binding = 0, std430) buffer neighbour_lists{
+  // max_neighbours slots per particle
+  uint neighbour[];
+};
+layout(set = 1, binding = 1, std430) buffer neighbour_counts{
+  uint neighbour_count[];
+};
+// where each particle was when the lists were built
+layout(set = 1, binding = 2, std430) buffer list_origins{
+  vec2 origin[];
+};
+
+// matches VerletState in ubo.hpp
+layout(set = 1, binding = 3, std430) buffer verlet_state{
+  // bits of the furthest any particle got from its origin, which compare
+  // like the floats since they're never negative. the host sets it to
+  // infinity whenever the lists have to be built regardless
+  uint max_displacement;
+  // builds so far
+  uint builds;
+  // the indirect dispatches of the build's passes over every particle, of
+  // the scan's single workgroup and of its passes over every tile of cells,
+  // no workgroups at all while the lists hold
+  uint particle_dispatch[3];
+  uint scan_dispatch[3];
+  uint block_dispatch[3];
+  // lists cut short over every build
+  uint overflows;
+};
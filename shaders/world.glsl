@@ -0,0 +1,138 @@
+// shared by every simulation kernel, pulled in with GL_GOOGLE_include_directive
+#extension GL_KHR_shader_subgroup_arithmetic : require
+
+// the host picks the workgroup size through specialization constant 5, every
+// kernel is one dimensional
+layout(local_size_x_id = 5) in;
+const uint work_size = gl_WorkGroupSize.x;
+
+layout(constant_id = 0) const uint count = 4;
+layout(constant_id = 1) const float max_x = 300;
+layout(constant_id = 2) const float max_y = 300;
+// velocities are two halves packed into one word instead of two floats
+layout(constant_id = 6) const bool half_velocity = false;
+const float radius = 1.0;
+
+layout(push_constant) uniform step_constants{
+  // seconds per step, velocities are in units per second
+  float dt;
+  // frame in flight whose observables slot the reduction writes
+  uint slot;
+};
+
+// the state is double buffered, a step reads the first three bindings and
+// writes the next three and the host swaps the two buffers between steps.
+// each array is its own range of the buffer so they can all be runtime sized.
+// velocities go through load_vel and store_vel since their layout depends
+// on half_velocity, colors are rgba8
+layout(binding = 0, std430) readonly buffer pos_in{
+  vec2 s[];
+};
+layout(binding = 1, std430) readonly buffer vel_in{
+  uint v_words[];
+};
+layout(binding = 2, std430) readonly buffer color_in{
+  uint color[];
+};
+
+layout(binding = 3, std430) writeonly buffer pos_next{
+  vec2 s_out[];
+};
+layout(binding = 4, std430) writeonly buffer vel_next{
+  uint v_out_words[];
+};
+layout(binding = 5, std430) writeonly buffer color_next{
+  uint color_out[];
+};
+
+vec2 load_vel(uint i) {
+  if (half_velocity)
+    return unpackHalf2x16(v_words[i]);
+  return uintBitsToFloat(uvec2(v_words[2 * i], v_words[2 * i + 1]));
+}
+
+void store_vel(uint i, vec2 value) {
+  if (half_velocity) {
+    v_out_words[i] = packHalf2x16(value);
+  } else {
+    uvec2 words = floatBitsToUint(value);
+    v_out_words[2 * i] = words.x;
+    v_out_words[2 * i + 1] = words.y;
+  }
+}
+
+// per workgroup sums of the reduction's first pass
+struct Partial {
+  vec2 momentum;
+  float kinetic;
+  float max_speed;
+};
+
+layout(binding = 6, std430) buffer reduction{
+  // particles that touched another this frame, cleared by the reduction
+  uint collisions;
+  uint reserved;
+  Partial partials[];
+};
+
+void bounds_check(inout vec2 pos, inout vec2 vel) {
+  if (pos.x + radius > max_x) {
+    pos.x -= pos.x - max_x + radius;
+    vel.x *= -1;
+  } else if (pos.x < radius) {
+    pos.x -= pos.x - radius;
+    vel.x *= -1;
+  }
+  if (pos.y + radius > max_y) {
+    pos.y -= pos.y - max_y + radius;
+    vel.y *= -1;
+  } else if (pos.y < radius) {
+    pos.y -= pos.y - radius;
+    vel.y *= -1;
+  }
+}
+
+// adds the elastic response of a particle at pos moving at vel to another
+// particle onto delta_v, returns whether they touch
+bool collide(vec2 pos, vec2 vel, vec2 other_pos, vec2 other_vel,
+             inout vec2 delta_v) {
+  if (distance(pos, other_pos) >= radius * 2)
+    return false;
+  vec2 ds = pos - other_pos;
+  delta_v -= dot(vel - other_vel, ds) / dot(ds, ds) * ds;
+  return true;
+}
+
+bool collide(uint id, uint i, inout vec2 delta_v) {
+  return i != id &&
+         collide(s[id], load_vel(id), s[i], load_vel(i), delta_v);
+}
+
+// writes particle id one step ahead into world_next, returns where it ended
+// up
+vec2 integrate(uint id, vec2 delta_v, bool hit) {
+  vec2 pos = s[id];
+  vec2 vel = load_vel(id) + delta_v;
+  vec4 col = unpackUnorm4x8(color[id]);
+
+  uint hits = subgroupAdd(hit ? 1 : 0);
+  if (subgroupElect() && hits != 0) {
+    atomicAdd(collisions, hits);
+  }
+
+  // the red flash fades out over a tenth of a second. the color goes back
+  // through 8 bits, so a step shorter than a third of a millisecond would
+  // round its fade away and takes off one 8 bit step instead, fading faster
+  if (col.r > 0.2) {
+    col.r -= max(6.0 * dt, 1.0 / 255.0);
+  }
+  if (hit) {
+    col.r = 0.8;
+  }
+  pos += vel * dt;
+  bounds_check(pos, vel);
+  s_out[id] = pos;
+  store_vel(id, vel);
+  color_out[id] = packUnorm4x8(col);
+  return pos;
+}
@@ -0,0 +1,184 @@
+#include "allocator.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace {
+constexpr vk::DeviceSize default_block = 64 << 20;
+
+vk::DeviceSize alignUp(vk::DeviceSize offset, vk::DeviceSize alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+// carves size bytes aligned to alignment out of the first free range they
+// fit in, returns the offset or nothing
+std::optional<vk::DeviceSize> take(MemoryBlock &block, vk::DeviceSize size,
+                                   vk::DeviceSize alignment) {
+  for (auto it = block.free.begin(); it != block.free.end(); it++) {
+    auto [start, length] = *it;
+    auto offset = alignUp(start, alignment);
+    if (offset + size > start + length)
+      continue;
+    // the padding in front stays free, so does whatever is left behind
+    block.free.erase(it);
+    if (offset != start)
+      block.free.emplace(start, offset - start);
+    if (offset + size != start + length)
+      block.free.emplace(offset + size, start + length - offset - size);
+    return offset;
+  }
+  return std::nullopt;
+}
+
+// gives back [offset, offset + size) and merges it with the ranges on either
+// side
+void give(MemoryBlock &block, vk::DeviceSize offset, vk::DeviceSize size) {
+  auto next = block.free.lower_bound(offset);
+  if (next != block.free.end() && offset + size == next->first) {
+    size += next->second;
+    next = block.free.erase(next);
+  }
+  if (next != block.free.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+  block.free.emplace(offset, size);
+}
+} // namespace
+
+float HeapStats::fragmentation() const noexcept {
+  auto free = reserved - used;
+  if (free == 0)
+    return 0;
+  return 1 - float(largest_free) / float(free);
+}
+
+Allocator::Allocator(vk::Device device, vk::PhysicalDevice phys)
+    : device(device), properties(phys.getMemoryProperties()) {}
+
+Allocator::~Allocator() {
+  for (auto &block : blocks) {
+    if (block.mapped)
+      device.unmapMemory(block.memory);
+    device.freeMemory(block.memory);
+  }
+}
+
+vk::DeviceSize Allocator::blockSize(uint32_t type) const {
+  auto heap = properties.memoryHeaps[properties.memoryTypes[type].heapIndex];
+  // small heaps like the host visible window into vram would otherwise be
+  // taken up by a block or two
+  return std::min(default_block, heap.size / 8);
+}
+
+MemoryBlock &Allocator::grow(uint32_t type, bool linear, vk::DeviceSize size) {
+  auto dedicated = size > blockSize(type) / 2;
+  auto &block = blocks.emplace_back(MemoryBlock{
+      .size = dedicated ? size : blockSize(type),
+      .type = type,
+      .linear = linear,
+      .dedicated = dedicated});
+  try {
+    block.memory = device.allocateMemory(
+        {.allocationSize = block.size, .memoryTypeIndex = type});
+  } catch (...) {
+    blocks.pop_back();
+    throw;
+  }
+  if (properties.memoryTypes[type].propertyFlags &
+      vk::MemoryPropertyFlagBits::eHostVisible)
+    block.mapped = device.mapMemory(block.memory, 0, vk::WholeSize);
+  block.free.emplace(0, block.size);
+  return block;
+}
+
+Allocation Allocator::allocate(const vk::MemoryRequirements &reqs,
+                               vk::MemoryPropertyFlags flags, bool linear) {
+  auto guard = std::lock_guard(mutex);
+  // the first type with the properties is the one the driver prefers, the
+  // others are only there if it's full
+  std::optional<vk::OutOfDeviceMemoryError> full;
+  for (uint32_t type = 0; type < properties.memoryTypeCount; type++) {
+    if (!(reqs.memoryTypeBits & (1u << type)) ||
+        (properties.memoryTypes[type].propertyFlags & flags) != flags)
+      continue;
+
+    MemoryBlock *found = nullptr;
+    std::optional<vk::DeviceSize> offset;
+    for (auto &block : blocks) {
+      if (block.type != type || block.linear != linear || block.dedicated)
+        continue;
+      if ((offset = take(block, reqs.size, reqs.alignment))) {
+        found = &block;
+        break;
+      }
+    }
+    if (!found) {
+      try {
+        found = &grow(type, linear, reqs.size);
+      } catch (const vk::OutOfDeviceMemoryError &e) {
+        full = e;
+        continue;
+      }
+      offset = take(*found, reqs.size, reqs.alignment);
+    }
+
+    found->used += reqs.size;
+    found->allocations++;
+    return {.memory = found->memory,
+            .offset = *offset,
+            .size = reqs.size,
+            .mapped = found->mapped
+                          ? static_cast<char *>(found->mapped) + *offset
+                          : nullptr,
+            .block = found};
+  }
+  if (full)
+    throw *full;
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+void Allocator::free(Allocation &allocation) {
+  if (!allocation)
+    return;
+  auto guard = std::lock_guard(mutex);
+  auto &block = *allocation.block;
+  block.used -= allocation.size;
+  block.allocations--;
+  give(block, allocation.offset, allocation.size);
+  allocation = {};
+  if (block.dedicated && block.allocations == 0) {
+    if (block.mapped)
+      device.unmapMemory(block.memory);
+    device.freeMemory(block.memory);
+    blocks.remove_if([&](auto &b) { return &b == &block; });
+  }
+}
+
+std::vector<HeapStats> Allocator::stats() const {
+  auto guard = std::lock_guard(mutex);
+  std::vector<HeapStats> heaps(properties.memoryHeapCount);
+  for (uint32_t i = 0; i < properties.memoryHeapCount; i++) {
+    heaps[i].flags = properties.memoryHeaps[i].flags;
+    heaps[i].heap_size = properties.memoryHeaps[i].size;
+  }
+  for (auto &block : blocks) {
+    auto &heap = heaps[properties.memoryTypes[block.type].heapIndex];
+    heap.reserved += block.size;
+    heap.used += block.used;
+    heap.blocks++;
+    heap.allocations += block.allocations;
+    for (auto [offset, size] : block.free)
+      heap.largest_free = std::max(heap.largest_free, size);
+  }
+  return heaps;
+}
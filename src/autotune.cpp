@@ -0,0 +1,159 @@
+#include "autotune.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "constants.hpp"
+#include "headless.hpp"
+#include "pipeline_cache.hpp"
+#include "util/replace_file.hpp"
+
+namespace {
+namespace fs = std::filesystem;
+
+// wall clock each candidate is stepped for, on top of its warmup batch
+constexpr double tune_seconds = 0.1;
+// a tenth of the bench's time per candidate, on top of a warmup batch of
+// max_substeps steps that runs to the end whatever it costs. a fifth of the
+// bench's cap makes an all pairs step 25 times cheaper, which keeps that
+// batch within the budget too
+constexpr uint32_t max_tuned_all_pairs = max_all_pairs / 5;
+
+// one line per world in the file, the key and then the winner. anything that
+// changes which candidate wins goes into the key, the pinned kernel or
+// workgroup size too, since the best size for one kernel isn't the best
+// overall
+std::string key(Context &context, const Options &options) {
+  using world::constants;
+  return fmt::format(
+      "{} {} {} {} {} {} {} {} {}",
+      context.phys.getProperties().driverVersion, constants.obj_count,
+      constants.max_x, constants.max_y, constants.half_velocity,
+      constants.skin, options.reorder_every,
+      options.kernel_given ? name(options.kernel) : "any",
+      options.work_size_given ? options.work_size : 0);
+}
+
+std::vector<std::string> readLines(const fs::path &path) {
+  std::vector<std::string> lines;
+  auto file = std::ifstream(path);
+  for (std::string line; std::getline(file, line);)
+    lines.push_back(std::move(line));
+  return lines;
+}
+
+std::optional<Tuning> load(const fs::path &path, std::string_view key) {
+  for (auto &line : readLines(path)) {
+    if (!line.starts_with(key) || line.size() <= key.size() ||
+        line[key.size()] != ' ')
+      continue;
+    auto rest = std::string_view(line).substr(key.size() + 1);
+    auto space = rest.find(' ');
+    if (space == std::string_view::npos)
+      return std::nullopt;
+    auto kernel = parseKernel(rest.substr(0, space));
+    uint32_t work_size = 0;
+    auto size = rest.substr(space + 1);
+    auto [end, err] =
+        std::from_chars(size.data(), size.data() + size.size(), work_size);
+    if (!kernel || err != std::errc{} || end != size.data() + size.size() ||
+        work_size == 0)
+      return std::nullopt;
+    return Tuning{*kernel, work_size};
+  }
+  return std::nullopt;
+}
+
+// replaces key's line, renamed over the old file like the pipeline cache
+void save(const fs::path &path, std::string_view key, Tuning tuning) {
+  auto lines = readLines(path);
+  std::erase_if(lines, [&](auto &line) {
+    return line.starts_with(key) && line.size() > key.size() &&
+           line[key.size()] == ' ';
+  });
+  lines.push_back(
+      fmt::format("{} {} {}", key, name(tuning.kernel), tuning.work_size));
+  replaceFile(path, "tuning", [&](std::ofstream &file) {
+    for (auto &line : lines)
+      file << line << '\n';
+  });
+}
+} // namespace
+
+Tuning autotune(Context &context, const Options &options) {
+  auto given = Tuning{options.kernel, options.work_size};
+  if (options.tune == Tune::off ||
+      (options.kernel_given && options.work_size_given))
+    return given;
+
+  auto path = deviceCachePath(context.phys, "tuning", "txt");
+  auto world_key = key(context, options);
+  if (options.tune == Tune::cached && !path.empty()) {
+    if (auto tuned = load(path, world_key)) {
+      fmt::print("tuned earlier: {} kernel, workgroup {}\n",
+                 name(tuned->kernel), tuned->work_size);
+      return *tuned;
+    }
+  }
+
+  auto kernels = options.kernel_given ? std::vector{options.kernel}
+                                      : options.kernels;
+  auto work_sizes = options.work_size_given
+                        ? std::vector{options.work_size}
+                        : options.work_sizes;
+  auto limits = context.phys.getProperties().limits;
+  auto max_work_size = std::min(limits.maxComputeWorkGroupSize[0],
+                                limits.maxComputeWorkGroupInvocations);
+  std::erase_if(work_sizes, [&](auto s) { return s > max_work_size; });
+  if (!options.kernel_given && world::constants.obj_count > max_tuned_all_pairs)
+    std::erase_if(kernels, allPairs);
+
+  fmt::print("tuning {} particles on {}\n", world::constants.obj_count,
+             context.phys.getProperties().deviceName.data());
+  auto saved_work_size = world::constants.work_size;
+  std::optional<Tuning> best;
+  double best_seconds = 0;
+  for (auto kernel : kernels) {
+    for (auto work_size : work_sizes) {
+      world::constants.work_size = work_size;
+      try {
+        auto run = measureGpu(context, options, kernel, tune_seconds);
+        // the gpu's own clock leaves out the host, which is the same for
+        // every candidate
+        auto seconds = run.gpu_seconds.value_or(run.seconds) / run.steps;
+        fmt::print("{:>8}, workgroup {:>4}: {:.3f} ms/step\n", name(kernel),
+                   work_size, seconds * 1e3);
+        if (!best || seconds < best_seconds) {
+          best = Tuning{kernel, work_size};
+          best_seconds = seconds;
+        }
+      } catch (const std::exception &e) {
+        fmt::print("{:>8}, workgroup {:>4}: skipped, {}\n", name(kernel),
+                   work_size, e.what());
+        context.device.waitIdle();
+      }
+    }
+  }
+  world::constants.work_size = saved_work_size;
+  if (!best) {
+    fmt::print("no candidate ran, keeping the {} kernel, workgroup {}\n",
+               name(given.kernel), given.work_size);
+    return given;
+  }
+
+  fmt::print("tuned: {} kernel, workgroup {}\n", name(best->kernel),
+             best->work_size);
+  if (!path.empty())
+    save(path, world_key, *best);
+  return *best;
+}
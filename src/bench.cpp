@@ -0,0 +1,164 @@
+#include "bench.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fmt/core.h>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "constants.hpp"
+#include "context.hpp"
+#include "headless.hpp"
+#include "util/scope_guard.hpp"
+
+namespace {
+// wall clock each configuration is measured for
+constexpr double target_seconds = 1;
+
+struct Result {
+  Kernel kernel;
+  uint32_t count, work_size;
+  GpuRun run;
+
+  double stepsPerSecond() const { return run.steps / run.seconds; }
+};
+
+struct Device {
+  std::string name, driver;
+};
+
+Device describe(Context &context) {
+  auto chain = context.phys.getProperties2<
+      vk::PhysicalDeviceProperties2, vk::PhysicalDeviceDriverProperties>();
+  auto &props = chain.get<vk::PhysicalDeviceProperties2>().properties;
+  auto &driver = chain.get<vk::PhysicalDeviceDriverProperties>();
+  return {.name = props.deviceName.data(),
+          .driver = fmt::format("{} {} ({:#x})", driver.driverName.data(),
+                                driver.driverInfo.data(),
+                                props.driverVersion)};
+}
+
+// a csv field, where quotes are doubled and anything else goes in as it is
+std::string quoteCsv(std::string_view s) {
+  std::string result = "\"";
+  for (char c : s) {
+    if (c == '"')
+      result += '"';
+    result += c;
+  }
+  return result + '"';
+}
+
+// a json string. some drivers put newlines and tabs into their info, which
+// json only allows escaped
+std::string quoteJson(std::string_view s) {
+  std::string result = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      result += '\\';
+    if (static_cast<unsigned char>(c) < 0x20)
+      result += fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+    else
+      result += c;
+  }
+  return result + '"';
+}
+
+std::FILE *open(const std::string &path) {
+  auto file = std::fopen(path.c_str(), "w");
+  if (!file)
+    throw std::runtime_error(fmt::format("can't write to {}", path));
+  return file;
+}
+
+void writeCsv(const std::string &path, const Device &device,
+              const std::vector<Result> &results) {
+  auto file = open(path);
+  auto guard = ScopeGuard([&]() { std::fclose(file); });
+  fmt::print(file, "device,driver,kernel,count,workgroup,steps,seconds,"
+                   "steps_per_s,particle_steps_per_s,gpu_ms_per_step\n");
+  for (auto &r : results) {
+    auto gpu = r.run.gpu_seconds
+                   ? fmt::format("{}", *r.run.gpu_seconds * 1e3 / r.run.steps)
+                   : std::string();
+    fmt::print(file, "{},{},{},{},{},{},{},{},{},{}\n", quoteCsv(device.name),
+               quoteCsv(device.driver), name(r.kernel), r.count,
+               r.work_size, r.run.steps, r.run.seconds, r.stepsPerSecond(),
+               r.stepsPerSecond() * r.count, gpu);
+  }
+}
+
+void writeJson(const std::string &path, const Device &device,
+               const std::vector<Result> &results) {
+  auto file = open(path);
+  auto guard = ScopeGuard([&]() { std::fclose(file); });
+  fmt::print(file, "{{\n  \"device\": {},\n  \"driver\": {},\n  \"runs\": [",
+             quoteJson(device.name), quoteJson(device.driver));
+  for (size_t i = 0; i < results.size(); i++) {
+    auto &r = results[i];
+    auto gpu = r.run.gpu_seconds
+                   ? fmt::format("{}", *r.run.gpu_seconds * 1e3 / r.run.steps)
+                   : std::string("null");
+    fmt::print(file,
+               "{}\n    {{\"kernel\": \"{}\", \"count\": {}, "
+               "\"workgroup\": {}, \"steps\": {}, \"seconds\": {}, "
+               "\"steps_per_s\": {}, \"particle_steps_per_s\": {}, "
+               "\"gpu_ms_per_step\": {}}}",
+               i ? "," : "", name(r.kernel), r.count, r.work_size, r.run.steps,
+               r.run.seconds, r.stepsPerSecond(), r.stepsPerSecond() * r.count,
+               gpu);
+  }
+  fmt::print(file, "\n  ]\n}}\n");
+}
+} // namespace
+
+int runBench(const Options &options) {
+  // validation would slow every candidate down by a different amount
+  auto context = Context(Headless{.validation = false});
+  auto device = describe(context);
+  fmt::print("benchmarking {} with {}\n", device.name, device.driver);
+  if (options.reorder_every != 0)
+    fmt::print("reordering the particles every {} steps\n",
+               options.reorder_every);
+
+  std::vector<Result> results;
+  for (auto count : options.counts) {
+    for (auto kernel : options.kernels) {
+      if (allPairs(kernel) && count > max_all_pairs)
+        continue;
+      for (auto work_size : options.work_sizes) {
+        world::configure(count);
+        world::constants.work_size = work_size;
+        fmt::print("{:>8} {:>9} particles, workgroup {:>4}: ", name(kernel),
+                   count, work_size);
+        std::fflush(stdout);
+        try {
+          auto run = measureGpu(context, options, kernel, target_seconds);
+          results.push_back({kernel, count, work_size, run});
+          auto &r = results.back();
+          fmt::print("{:10.1f} steps/s, {:.3e} particle steps/s",
+                     r.stepsPerSecond(), r.stepsPerSecond() * count);
+          if (run.gpu_seconds)
+            fmt::print(", {:.3f} gpu ms/step",
+                       *run.gpu_seconds * 1e3 / run.steps);
+          fmt::print("\n");
+        } catch (const std::exception &e) {
+          // out of memory or over the device's workgroup limit, the rest of
+          // the sweep can still run
+          fmt::print("skipped, {}\n", e.what());
+          context.device.waitIdle();
+        }
+      }
+    }
+  }
+
+  writeCsv(options.output + ".csv", device, results);
+  writeJson(options.output + ".json", device, results);
+  fmt::print("wrote {0}.csv and {0}.json\n", options.output);
+  return 0;
+}
@@ -0,0 +1,150 @@
+#include "checkpoint.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fmt/core.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+#include "constants.hpp"
+#include "util/replace_file.hpp"
+#include "util/scope_guard.hpp"
+
+namespace {
+uint64_t alignUp(uint64_t offset) {
+  return (offset + CheckpointHeader::alignment - 1) /
+         CheckpointHeader::alignment * CheckpointHeader::alignment;
+}
+
+std::runtime_error systemError(std::string_view what,
+                               const std::filesystem::path &path) {
+  return std::runtime_error(
+      fmt::format("{} {}: {}", what, path.string(), std::strerror(errno)));
+}
+} // namespace
+
+Checkpoint::Checkpoint(const std::filesystem::path &path) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw systemError("can't open checkpoint", path);
+  auto close_fd = ScopeGuard([&]() { ::close(fd); });
+  struct stat info;
+  if (::fstat(fd, &info) != 0)
+    throw systemError("can't stat checkpoint", path);
+  size = static_cast<size_t>(info.st_size);
+  if (size < sizeof(CheckpointHeader))
+    throw std::runtime_error(
+        fmt::format("{} is too short to be a checkpoint", path.string()));
+
+  auto mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED)
+    throw systemError("can't map checkpoint", path);
+  // read front to back exactly once by the upload
+  ::madvise(mapping, size, MADV_SEQUENTIAL);
+  data = static_cast<const std::byte *>(mapping);
+  head = reinterpret_cast<const CheckpointHeader *>(data);
+
+  auto fits = [&](uint64_t offset, size_t element) {
+    return offset % alignof(glm::vec4) == 0 && offset <= size &&
+           head->count <= (size - offset) / element;
+  };
+  auto &h = *head;
+  const char *problem = nullptr;
+  if (h.magic != CheckpointHeader::file_magic)
+    problem = "isn't a checkpoint";
+  else if (h.version != CheckpointHeader::current_version)
+    problem = "was written by another version";
+  else if (h.size != size || !fits(h.pos, sizeof(glm::vec2)) ||
+           !fits(h.vel, sizeof(glm::vec2)) ||
+           !fits(h.color, sizeof(uint32_t)))
+    problem = "is truncated or corrupt";
+  else if (h.count < 2 || !(h.max_x > 0) || !(h.max_y > 0))
+    problem = "holds no usable world";
+  if (problem) {
+    ::munmap(mapping, size);
+    throw std::runtime_error(fmt::format("{} {}", path.string(), problem));
+  }
+}
+
+Checkpoint::~Checkpoint() {
+  ::munmap(const_cast<std::byte *>(data), size);
+}
+
+std::span<const glm::vec2> Checkpoint::pos() const noexcept {
+  return {reinterpret_cast<const glm::vec2 *>(data + head->pos), head->count};
+}
+
+std::span<const glm::vec2> Checkpoint::vel() const noexcept {
+  return {reinterpret_cast<const glm::vec2 *>(data + head->vel), head->count};
+}
+
+std::span<const uint32_t> Checkpoint::color() const noexcept {
+  return {reinterpret_cast<const uint32_t *>(data + head->color),
+          head->count};
+}
+
+WorldS Checkpoint::world() const {
+  return {.pos = {pos().begin(), pos().end()},
+          .vel = {vel().begin(), vel().end()},
+          .color = {color().begin(), color().end()}};
+}
+
+void writeCheckpoint(const std::filesystem::path &path, uint64_t step,
+                     std::span<const glm::vec2> pos,
+                     std::span<const glm::vec2> vel,
+                     std::span<const uint32_t> color) {
+  CheckpointHeader header{
+      .count = static_cast<uint32_t>(pos.size()),
+      .max_x = world::constants.max_x,
+      .max_y = world::constants.max_y,
+      .step = step,
+  };
+  header.pos = alignUp(sizeof(header));
+  header.vel = alignUp(header.pos + pos.size_bytes());
+  header.color = alignUp(header.vel + vel.size_bytes());
+  header.size = header.color + color.size_bytes();
+
+  // named apart per process and call like replaceFile's temporaries. two
+  // saves to one path would otherwise truncate a file the other has mapped,
+  // which kills it with SIGBUS
+  auto temp = path;
+  temp += fmt::format(".{}.{}.partial", ::getpid(),
+                      detail::replace_counter++);
+  auto fd = ::open(temp.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw systemError("can't create checkpoint", temp);
+  // a failed write leaves nothing behind, the guard runs after the close
+  bool renamed = false;
+  auto remove_temp = ScopeGuard([&]() {
+    std::error_code err;
+    if (!renamed)
+      std::filesystem::remove(temp, err);
+  });
+  auto close_fd = ScopeGuard([&]() { ::close(fd); });
+  if (::ftruncate(fd, static_cast<off_t>(header.size)) != 0)
+    throw systemError("can't size checkpoint", temp);
+
+  // written through a mapping as well, the page cache takes the copies
+  // directly and the header goes in last
+  auto mapping =
+      ::mmap(nullptr, header.size, PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED)
+    throw systemError("can't map checkpoint", temp);
+  auto bytes = static_cast<std::byte *>(mapping);
+  std::memcpy(bytes + header.pos, pos.data(), pos.size_bytes());
+  std::memcpy(bytes + header.vel, vel.data(), vel.size_bytes());
+  std::memcpy(bytes + header.color, color.data(), color.size_bytes());
+  std::memcpy(bytes, &header, sizeof(header));
+  auto synced = ::msync(mapping, header.size, MS_SYNC) == 0;
+  ::munmap(mapping, header.size);
+  if (!synced)
+    throw systemError("can't write checkpoint", temp);
+
+  std::filesystem::rename(temp, path);
+  renamed = true;
+}
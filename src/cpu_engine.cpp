@@ -0,0 +1,312 @@
+#include "cpu_engine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <numeric>
+
+#include "constants.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PARTSIM_X86 1
+#endif
+
+namespace {
+constexpr float reach = 4 * world::radius * world::radius;
+
+// a particle's neighbours are the 3x3 cells around it, one run per row
+constexpr int rows = 3;
+
+bool collideScalar(CpuEngine::Particles p, const CpuEngine::Run *runs,
+                   uint32_t self, float dv[2]) {
+  bool hit = false;
+  for (int r = 0; r < rows; r++) {
+    for (uint32_t i = runs[r].begin; i < runs[r].end; i++) {
+      float dx = p.x[self] - p.x[i], dy = p.y[self] - p.y[i];
+      float d2 = dx * dx + dy * dy;
+      if (i == self || !(d2 < reach))
+        continue;
+      float k =
+          ((p.vx[self] - p.vx[i]) * dx + (p.vy[self] - p.vy[i]) * dy) / d2;
+      dv[0] -= k * dx;
+      dv[1] -= k * dy;
+      hit = true;
+    }
+  }
+  return hit;
+}
+
+#ifdef PARTSIM_X86
+__attribute__((target("avx2,fma"))) float sum(__m256 v) {
+  auto half =
+      _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_movehdup_ps(half));
+  return _mm_cvtss_f32(half);
+}
+
+// eight particles at a time with the tail masked off
+__attribute__((target("avx2,fma"))) bool
+collideAvx2(CpuEngine::Particles p, const CpuEngine::Run *runs,
+            uint32_t self, float dv[2]) {
+  auto px = _mm256_set1_ps(p.x[self]), py = _mm256_set1_ps(p.y[self]);
+  auto pvx = _mm256_set1_ps(p.vx[self]), pvy = _mm256_set1_ps(p.vy[self]);
+  auto limit = _mm256_set1_ps(reach);
+  auto lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  auto me = _mm256_set1_epi32(static_cast<int>(self));
+  auto dvx = _mm256_setzero_ps(), dvy = _mm256_setzero_ps();
+  auto hits = _mm256_setzero_ps();
+  for (int r = 0; r < rows; r++) {
+    auto end = _mm256_set1_epi32(static_cast<int>(runs[r].end));
+    for (uint32_t i = runs[r].begin; i < runs[r].end; i += 8) {
+      auto index =
+          _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(i)), lanes);
+      auto live = _mm256_cmpgt_epi32(end, index);
+      auto dx = _mm256_sub_ps(px, _mm256_maskload_ps(p.x + i, live));
+      auto dy = _mm256_sub_ps(py, _mm256_maskload_ps(p.y + i, live));
+      auto d2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+      auto candidate =
+          _mm256_andnot_si256(_mm256_cmpeq_epi32(index, me), live);
+      auto near = _mm256_and_ps(_mm256_castsi256_ps(candidate),
+                                _mm256_cmp_ps(d2, limit, _CMP_LT_OQ));
+      auto rvx = _mm256_sub_ps(pvx, _mm256_maskload_ps(p.vx + i, live));
+      auto rvy = _mm256_sub_ps(pvy, _mm256_maskload_ps(p.vy + i, live));
+      auto dot = _mm256_fmadd_ps(rvx, dx, _mm256_mul_ps(rvy, dy));
+      // self and the masked off lanes divide by zero, the mask drops the nan
+      auto k = _mm256_and_ps(near, _mm256_div_ps(dot, d2));
+      dvx = _mm256_fnmadd_ps(k, dx, dvx);
+      dvy = _mm256_fnmadd_ps(k, dy, dvy);
+      hits = _mm256_or_ps(hits, near);
+    }
+  }
+  dv[0] += sum(dvx);
+  dv[1] += sum(dvy);
+  return _mm256_movemask_ps(hits) != 0;
+}
+
+// sixteen particles at a time with the tail masked off
+__attribute__((target("avx512f"))) bool
+collideAvx512(CpuEngine::Particles p, const CpuEngine::Run *runs,
+              uint32_t self, float dv[2]) {
+  auto px = _mm512_set1_ps(p.x[self]), py = _mm512_set1_ps(p.y[self]);
+  auto pvx = _mm512_set1_ps(p.vx[self]), pvy = _mm512_set1_ps(p.vy[self]);
+  auto limit = _mm512_set1_ps(reach);
+  auto lanes = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13,
+                                 14, 15);
+  auto me = _mm512_set1_epi32(static_cast<int>(self));
+  auto dvx = _mm512_setzero_ps(), dvy = _mm512_setzero_ps();
+  __mmask16 hits = 0;
+  for (int r = 0; r < rows; r++) {
+    auto end = runs[r].end;
+    for (uint32_t i = runs[r].begin; i < end; i += 16) {
+      __mmask16 live = end - i >= 16 ? 0xffff : (1u << (end - i)) - 1;
+      auto dx = _mm512_sub_ps(px, _mm512_maskz_loadu_ps(live, p.x + i));
+      auto dy = _mm512_sub_ps(py, _mm512_maskz_loadu_ps(live, p.y + i));
+      auto d2 = _mm512_fmadd_ps(dx, dx, _mm512_mul_ps(dy, dy));
+      auto index =
+          _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(i)), lanes);
+      __mmask16 near = _mm512_mask_cmp_ps_mask(live, d2, limit, _CMP_LT_OQ) &
+                       ~_mm512_cmpeq_epi32_mask(index, me);
+      auto rvx = _mm512_sub_ps(pvx, _mm512_maskz_loadu_ps(live, p.vx + i));
+      auto rvy = _mm512_sub_ps(pvy, _mm512_maskz_loadu_ps(live, p.vy + i));
+      auto dot = _mm512_fmadd_ps(rvx, dx, _mm512_mul_ps(rvy, dy));
+      auto k = _mm512_maskz_div_ps(near, dot, d2);
+      dvx = _mm512_fnmadd_ps(k, dx, dvx);
+      dvy = _mm512_fnmadd_ps(k, dy, dvy);
+      hits |= near;
+    }
+  }
+  dv[0] += _mm512_reduce_add_ps(dvx);
+  dv[1] += _mm512_reduce_add_ps(dvy);
+  return hits != 0;
+}
+#endif
+
+// the widest kernel this cpu runs
+CpuEngine::Kernel pickKernel() {
+#ifdef PARTSIM_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return {.collide = collideAvx512, .isa = "avx-512", .lanes = 16};
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return {.collide = collideAvx2, .isa = "avx2", .lanes = 8};
+#endif
+  return {.collide = collideScalar, .isa = "scalar", .lanes = 1};
+}
+
+// same as bounds_check in world.glsl
+void boundsCheck(float &x, float &y, float &vx, float &vy) {
+  using world::radius;
+  auto max_x = world::constants.max_x, max_y = world::constants.max_y;
+  if (x + radius > max_x) {
+    x -= x - max_x + radius;
+    vx *= -1;
+  } else if (x < radius) {
+    x -= x - radius;
+    vx *= -1;
+  }
+  if (y + radius > max_y) {
+    y -= y - max_y + radius;
+    vy *= -1;
+  } else if (y < radius) {
+    y -= y - radius;
+    vy *= -1;
+  }
+}
+
+// same as cell_coord and cell_index in grid.glsl
+uint32_t cellIndex(const CpuEngine::Grid &grid, float x, float y) {
+  auto w = static_cast<int>(grid.w), h = static_cast<int>(grid.h);
+  auto cx = std::clamp(static_cast<int>(std::floor(x / grid.cell_size)), 0,
+                       w - 1);
+  auto cy = std::clamp(static_cast<int>(std::floor(y / grid.cell_size)), 0,
+                       h - 1);
+  return static_cast<uint32_t>(cy * w + cx);
+}
+} // namespace
+
+void CpuEngine::State::resize(size_t count) {
+  x.resize(count);
+  y.resize(count);
+  vx.resize(count);
+  vy.resize(count);
+  color.resize(count);
+  id.resize(count);
+}
+
+void CpuEngine::State::copy(size_t from, State &to, size_t at) const {
+  to.x[at] = x[from];
+  to.y[at] = y[from];
+  to.vx[at] = vx[from];
+  to.vy[at] = vy[from];
+  to.color[at] = color[from];
+  to.id[at] = id[from];
+}
+
+CpuEngine::CpuEngine(const WorldS &start, unsigned threads)
+    : pool(threads), counters(pool.size()), kernel(pickKernel()) {
+  auto count = start.pos.size();
+  current.resize(count);
+  sorted.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    current.x[i] = start.pos[i].x;
+    current.y[i] = start.pos[i].y;
+    current.vx[i] = start.vel[i].x;
+    current.vy[i] = start.vel[i].y;
+    current.color[i] = unpackColor(start.color[i]);
+    current.id[i] = static_cast<uint32_t>(i);
+  }
+  cell_of.resize(count);
+  // cells at least as wide as the gpu's, wide enough that a row of three
+  // holds about one vector of particles at the average density. narrower
+  // cells leave most lanes empty and the loop overhead dominates
+  auto max_x = world::constants.max_x, max_y = world::constants.max_y;
+  auto density = count / (max_x * max_y);
+  grid.cell_size =
+      std::max(world::cell_size, std::sqrt(kernel.lanes / (3 * density)));
+  grid.w = static_cast<uint32_t>(std::ceil(max_x / grid.cell_size));
+  grid.h = static_cast<uint32_t>(std::ceil(max_y / grid.cell_size));
+  cell_start.resize(size_t(grid.w) * grid.h + 1);
+  cursor.resize(size_t(grid.w) * grid.h);
+}
+
+// the scatter is serial, it's a single pass over mostly sorted memory and
+// tiny next to the collision pass
+void CpuEngine::bin() {
+  auto count = current.x.size();
+  pool.parallelFor(count, 1 << 14, [&](size_t begin, size_t end, unsigned) {
+    for (size_t i = begin; i < end; i++) {
+      cell_of[i] = cellIndex(grid, current.x[i], current.y[i]);
+    }
+  });
+  std::ranges::fill(cursor, 0);
+  for (auto cell : cell_of) {
+    cursor[cell]++;
+  }
+  cell_start[0] = 0;
+  std::inclusive_scan(cursor.begin(), cursor.end(), cell_start.begin() + 1);
+  std::copy(cell_start.begin(), cell_start.end() - 1, cursor.begin());
+  for (size_t i = 0; i < count; i++) {
+    current.copy(i, sorted, cursor[cell_of[i]]++);
+  }
+}
+
+void CpuEngine::step(float dt) {
+  bin();
+  auto w = grid.w, h = grid.h;
+  auto in = Particles{.x = sorted.x.data(),
+                      .y = sorted.y.data(),
+                      .vx = sorted.vx.data(),
+                      .vy = sorted.vy.data()};
+  // rows of cells are handed out a few at a time so dense regions don't
+  // leave one thread working alone
+  auto grain = std::max<size_t>(1, h / (pool.size() * 8));
+  pool.parallelFor(h, grain, [&](size_t row_begin, size_t row_end,
+                                 unsigned thread) {
+    uint64_t hits = 0;
+    for (auto row = row_begin; row < row_end; row++) {
+      auto lo_y = row == 0 ? 0 : row - 1;
+      auto hi_y = std::min<size_t>(row + 1, h - 1);
+      for (uint32_t col = 0; col < w; col++) {
+        auto lo_x = col == 0 ? 0 : col - 1, hi_x = std::min(col + 1, w - 1);
+        auto cell = row * w + col;
+        for (auto p = cell_start[cell]; p < cell_start[cell + 1]; p++) {
+          float dv[2] = {0, 0};
+          // rows past the edge of the grid are left empty
+          Run runs[3] = {};
+          for (auto y = lo_y; y <= hi_y; y++) {
+            runs[y - lo_y] = {cell_start[y * w + lo_x],
+                              cell_start[y * w + hi_x + 1]};
+          }
+          bool hit = kernel.collide(in, runs, p, dv);
+
+          // integrate from world.glsl, written back in sorted order
+          sorted.copy(p, current, p);
+          auto &color = current.color[p];
+          if (color.r > 0.2f)
+            color.r -= 6.0f * dt;
+          if (hit)
+            color.r = 0.8f;
+          auto &vx = current.vx[p], &vy = current.vy[p];
+          vx += dv[0];
+          vy += dv[1];
+          current.x[p] += vx * dt;
+          current.y[p] += vy * dt;
+          boundsCheck(current.x[p], current.y[p], vx, vy);
+          hits += hit;
+        }
+      }
+    }
+    counters[thread].collisions += hits;
+  });
+}
+
+Observables CpuEngine::observe() {
+  Observables result{};
+  for (size_t i = 0; i < current.vx.size(); i++) {
+    auto vel = glm::vec2(current.vx[i], current.vy[i]);
+    result.momentum += vel;
+    result.kinetic += 0.5f * glm::dot(vel, vel);
+    result.max_speed = std::max(result.max_speed, glm::length(vel));
+  }
+  for (auto &counter : counters) {
+    result.collisions += counter.collisions;
+    counter.collisions = 0;
+  }
+  return result;
+}
+
+WorldS CpuEngine::world() const {
+  auto count = current.x.size();
+  WorldS result{.pos = std::vector<glm::vec2>(count),
+                .vel = std::vector<glm::vec2>(count),
+                .color = std::vector<uint32_t>(count)};
+  for (size_t i = 0; i < count; i++) {
+    auto id = current.id[i];
+    result.pos[id] = {current.x[i], current.y[i]};
+    result.vel[id] = {current.vx[i], current.vy[i]};
+    result.color[id] = packColor(current.color[i]);
+  }
+  return result;
+}
@@ -0,0 +1,316 @@
+#include "event_engine.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <limits>
+
+#include "constants.hpp"
+
+namespace {
+constexpr uint32_t none = UINT32_MAX;
+constexpr double diameter = 2 * world::radius;
+constexpr double infinity = std::numeric_limits<double>::infinity();
+// the heap is cleared of stale events once it holds this many per particle
+constexpr size_t max_queued = 16;
+
+// orders the queue into a min heap on time
+template <typename E> bool later(const E &a, const E &b) {
+  return a.time > b.time;
+}
+} // namespace
+
+EventEngine::EventEngine(const WorldS &start) {
+  auto count = start.pos.size();
+  auto box = glm::dvec2(world::constants.max_x, world::constants.max_y);
+  // about one particle per cell, fewer cells mean more pairs to predict and
+  // more mean more crossings
+  auto wanted = std::max(diameter, std::sqrt(box.x * box.y / count));
+  grid_w = std::max(1u, static_cast<uint32_t>(box.x / wanted));
+  grid_h = std::max(1u, static_cast<uint32_t>(box.y / wanted));
+  cell_size = box / glm::dvec2(grid_w, grid_h);
+  head.assign(size_t(grid_w) * grid_h, none);
+
+  particles.resize(count);
+  color = start.color;
+  for (uint32_t i = 0; i < count; i++) {
+    auto &p = particles[i];
+    p.pos = glm::clamp(glm::dvec2(start.pos[i]), glm::dvec2(world::radius),
+                       box - glm::dvec2(world::radius));
+    p.vel = glm::dvec2(start.vel[i]);
+    auto cell = glm::min(glm::uvec2(p.pos / cell_size),
+                         glm::uvec2(grid_w - 1, grid_h - 1));
+    link(i, cell.y * grid_w + cell.x);
+  }
+  // every pair is queued from both ends, whichever goes first turns the
+  // other stale
+  for (uint32_t i = 0; i < count; i++)
+    predict(i);
+}
+
+void EventEngine::link(uint32_t i, uint32_t cell) {
+  auto &p = particles[i];
+  p.cell = cell;
+  p.prev = none;
+  p.next = head[cell];
+  if (p.next != none)
+    particles[p.next].prev = i;
+  head[cell] = i;
+}
+
+void EventEngine::unlink(uint32_t i) {
+  auto &p = particles[i];
+  if (p.prev != none)
+    particles[p.prev].next = p.next;
+  else
+    head[p.cell] = p.next;
+  if (p.next != none)
+    particles[p.next].prev = p.prev;
+}
+
+void EventEngine::moveTo(Particle &p, double time) {
+  p.pos += p.vel * (time - p.time);
+  p.time = time;
+}
+
+void EventEngine::push(const Event &event) {
+  queue.push_back(event);
+  std::ranges::push_heap(queue, later<Event>);
+}
+
+bool EventEngine::stale(const Event &event) const {
+  if (particles[event.a].version != event.version_a)
+    return true;
+  return event.kind == Event::Kind::collision &&
+         particles[event.b].version != event.version_b;
+}
+
+void EventEngine::compact() {
+  auto before = queue.size();
+  std::erase_if(queue, [&](auto &event) { return stale(event); });
+  std::ranges::make_heap(queue, later<Event>);
+  counts.stale += before - queue.size();
+}
+
+void EventEngine::predictCells(uint32_t i, int x0, int x1, int y0, int y1) {
+  auto &p = particles[i];
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, static_cast<int>(grid_w) - 1);
+  y1 = std::min(y1, static_cast<int>(grid_h) - 1);
+  for (int y = y0; y <= y1; y++) {
+    for (int x = x0; x <= x1; x++) {
+      for (auto j = head[y * grid_w + x]; j != none;
+           j = particles[j].next) {
+        if (j == i)
+          continue;
+        auto &q = particles[j];
+        // q where it is at p's time
+        auto dr = p.pos - (q.pos + q.vel * (p.time - q.time));
+        auto dv = p.vel - q.vel;
+        auto b = glm::dot(dr, dv);
+        if (b >= 0)
+          continue;
+        // touching already and closing in, like the overlaps the stepped
+        // kernels leave behind, collides right away
+        auto gap = glm::dot(dr, dr) - diameter * diameter;
+        auto disc = b * b - glm::dot(dv, dv) * gap;
+        if (gap > 0 && disc < 0)
+          continue;
+        // the earlier root of |dr + dv t| = diameter, written so it doesn't
+        // cancel when the particles are almost touching
+        auto t = gap > 0 ? gap / (std::sqrt(disc) - b) : 0;
+        push({.time = p.time + t,
+              .kind = Event::Kind::collision,
+              .a = i,
+              .b = j,
+              .version_a = p.version,
+              .version_b = q.version});
+      }
+    }
+  }
+}
+
+void EventEngine::predict(uint32_t i) {
+  auto &p = particles[i];
+  auto x = static_cast<int>(p.cell % grid_w);
+  auto y = static_cast<int>(p.cell / grid_w);
+  predictCells(i, x - 1, x + 1, y - 1, y + 1);
+  predictBounce(i);
+  predictCrossing(i);
+}
+
+void EventEngine::predictBounce(uint32_t i) {
+  auto &p = particles[i];
+  auto box = glm::dvec2(world::constants.max_x, world::constants.max_y);
+  auto time = infinity;
+  uint32_t axis = 0;
+  for (uint32_t a = 0; a < 2; a++) {
+    double t = infinity;
+    if (p.vel[a] > 0)
+      t = (box[a] - world::radius - p.pos[a]) / p.vel[a];
+    else if (p.vel[a] < 0)
+      t = (world::radius - p.pos[a]) / p.vel[a];
+    if (t < time) {
+      time = t;
+      axis = a;
+    }
+  }
+  if (time != infinity)
+    push({.time = p.time + std::max(time, 0.0),
+          .kind = Event::Kind::bounce,
+          .a = i,
+          .b = axis,
+          .version_a = p.version,
+          .version_b = 0});
+}
+
+// the walls are inside the outermost cells, so nothing crosses out of the
+// grid
+void EventEngine::predictCrossing(uint32_t i) {
+  auto &p = particles[i];
+  auto cell = glm::uvec2(p.cell % grid_w, p.cell / grid_w);
+  auto grid = glm::uvec2(grid_w, grid_h);
+  auto stride = glm::uvec2(1, grid_w);
+  auto time = infinity;
+  uint32_t target = none;
+  for (uint32_t a = 0; a < 2; a++) {
+    double t = infinity;
+    uint32_t next = none;
+    if (p.vel[a] > 0 && cell[a] + 1 < grid[a]) {
+      t = ((cell[a] + 1) * cell_size[a] - p.pos[a]) / p.vel[a];
+      next = p.cell + stride[a];
+    } else if (p.vel[a] < 0 && cell[a] > 0) {
+      t = (cell[a] * cell_size[a] - p.pos[a]) / p.vel[a];
+      next = p.cell - stride[a];
+    }
+    if (t < time) {
+      time = t;
+      target = next;
+    }
+  }
+  if (target != none)
+    push({.time = p.time + std::max(time, 0.0),
+          .kind = Event::Kind::crossing,
+          .a = i,
+          .b = target,
+          .version_a = p.version,
+          .version_b = 0});
+}
+
+void EventEngine::collide(const Event &event) {
+  auto &p = particles[event.a], &q = particles[event.b];
+  moveTo(p, event.time);
+  moveTo(q, event.time);
+  // collide from world.glsl, which is the exact exchange of the velocity
+  // along the line between the centers when they're a diameter apart
+  auto dr = p.pos - q.pos;
+  // coincident centers, which a restored world can hold, have no line to
+  // push along and would turn the velocities into nans. the pair is left to
+  // pass through each other, its other events still hold
+  auto distance2 = glm::dot(dr, dr);
+  if (distance2 == 0)
+    return;
+  auto impulse = glm::dot(p.vel - q.vel, dr) / distance2 * dr;
+  p.vel -= impulse;
+  q.vel += impulse;
+  p.version++;
+  q.version++;
+  p.hit = q.hit = event.time;
+  counts.collisions++;
+  predict(event.a);
+  predict(event.b);
+}
+
+void EventEngine::bounce(const Event &event) {
+  auto &p = particles[event.a];
+  auto axis = event.b;
+  moveTo(p, event.time);
+  double wall = axis == 0 ? world::constants.max_x : world::constants.max_y;
+  p.pos[axis] = std::clamp(p.pos[axis], double(world::radius),
+                           wall - world::radius);
+  p.vel[axis] *= -1;
+  p.version++;
+  counts.bounces++;
+  predict(event.a);
+}
+
+// the course didn't change, so the particle's queued events hold and only
+// the cells that just came into reach are new
+void EventEngine::cross(const Event &event) {
+  auto i = event.a;
+  auto &p = particles[i];
+  moveTo(p, event.time);
+  auto from = glm::ivec2(p.cell % grid_w, p.cell / grid_w);
+  unlink(i);
+  link(i, event.b);
+  auto to = glm::ivec2(p.cell % grid_w, p.cell / grid_w);
+  auto ahead = to + (to - from);
+  if (to.x != from.x)
+    predictCells(i, ahead.x, ahead.x, to.y - 1, to.y + 1);
+  else
+    predictCells(i, to.x - 1, to.x + 1, ahead.y, ahead.y);
+  counts.crossings++;
+  predictCrossing(i);
+}
+
+void EventEngine::advance(double seconds) {
+  auto end = now + seconds;
+  while (!queue.empty() && queue.front().time <= end) {
+    std::ranges::pop_heap(queue, later<Event>);
+    auto event = queue.back();
+    queue.pop_back();
+    if (stale(event)) {
+      counts.stale++;
+      continue;
+    }
+    now = event.time;
+    switch (event.kind) {
+    case Event::Kind::collision:
+      collide(event);
+      break;
+    case Event::Kind::bounce:
+      bounce(event);
+      break;
+    case Event::Kind::crossing:
+      cross(event);
+      break;
+    }
+    if (queue.size() > max_queued * particles.size())
+      compact();
+  }
+  now = end;
+}
+
+Observables EventEngine::observe() {
+  Observables result{};
+  for (auto &p : particles) {
+    auto vel = glm::vec2(p.vel);
+    result.momentum += vel;
+    result.kinetic += 0.5f * glm::dot(vel, vel);
+    result.max_speed = std::max(result.max_speed, glm::length(vel));
+  }
+  result.collisions = static_cast<uint32_t>(2 * (counts.collisions - observed));
+  observed = counts.collisions;
+  return result;
+}
+
+WorldS EventEngine::world() const {
+  auto count = particles.size();
+  WorldS result{.pos = std::vector<glm::vec2>(count),
+                .vel = std::vector<glm::vec2>(count),
+                .color = color};
+  for (size_t i = 0; i < count; i++) {
+    auto &p = particles[i];
+    result.pos[i] = glm::vec2(p.pos + p.vel * (now - p.time));
+    result.vel[i] = glm::vec2(p.vel);
+    // integrate in world.glsl fades the flash out at the same rate
+    if (p.hit >= 0) {
+      auto flash = unpackColor(color[i]);
+      flash.r = std::max(0.2f, static_cast<float>(0.8 - 6 * (now - p.hit)));
+      result.color[i] = packColor(flash);
+    }
+  }
+  return result;
+}
@@ -37,13 +37,14 @@ GUI::GUI(Context &c, Renderer &vk) : device(c.device) {
   io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
   ImGui::StyleColorsDark();
 
-  ImGui_ImplSDL2_InitForVulkan(c.window.handle);
+  ImGui_ImplSDL2_InitForVulkan(c.window->handle);
   ImGui_ImplVulkan_InitInfo init_info = {};
   init_info.Instance = c.instance;
   init_info.PhysicalDevice = c.phys;
   init_info.Device = device;
   init_info.QueueFamily = c.indicies.graphics;
   init_info.Queue = c.queues.render();
+  init_info.PipelineCache = c.pipeline_cache;
   init_info.DescriptorPool = imgui_pool;
   init_info.MinImageCount = frames_in_flight;
   init_info.ImageCount = c.views.size();
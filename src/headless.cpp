@@ -0,0 +1,275 @@
+#include "headless.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fmt/core.h>
+#include <optional>
+#include <vulkan/vulkan.hpp>
+
+#include "autotune.hpp"
+#include "constants.hpp"
+#include "context.hpp"
+#include "cpu_engine.hpp"
+#include "event_engine.hpp"
+#include "simulation.hpp"
+#include "util/scope_guard.hpp"
+#include "util/vkassert.hpp"
+
+namespace {
+void report(const Options &options, double seconds,
+            const Observables &observed) {
+  auto rate = options.steps / seconds;
+  fmt::print("{} steps in {:.3f} s: {:.1f} steps/s, {:.3e} particle steps/s\n",
+             options.steps, seconds, rate,
+             rate * world::constants.obj_count);
+  fmt::print("final energy {}, momentum ({}, {}), max speed {}\n",
+             observed.kinetic, observed.momentum.x, observed.momentum.y,
+             observed.max_speed);
+}
+} // namespace
+
+GpuRun stepGpu(Context &context, Renderer &vk, Simulation &sim,
+              StagingRing &staging, uint64_t steps, uint32_t batch_size,
+              float dt, Recorder *recorder) {
+  using enum vk::PipelineStageFlagBits;
+  // two timestamps around every batch, one pair per command buffer. they are
+  // read back when the buffer comes around again so the host never stalls on
+  // them
+  auto families = context.phys.getQueueFamilyProperties();
+  auto valid_bits = families[vk.families.compute].timestampValidBits;
+  auto period = context.phys.getProperties().limits.timestampPeriod;
+  vk::QueryPool queries{};
+  if (valid_bits != 0)
+    queries = vk.device.createQueryPool(
+        {.queryType = vk::QueryType::eTimestamp,
+         .queryCount = 2 * frames_in_flight});
+  auto destroy_queries =
+      ScopeGuard([&]() { vk.device.destroyQueryPool(queries); });
+  // declared after the query pool so it's destroyed before it, and only once
+  // the queue is idle
+  auto buffers = vk.getComputeCommands(frames_in_flight);
+  auto free_buffers = ScopeGuard([&]() {
+    vk.queues.compute().waitIdle();
+    vk.device.freeCommandBuffers(vk.compute_pool, buffers);
+  });
+  uint64_t ticks = 0;
+  auto readTimestamps = [&](uint32_t slot) {
+    if (!queries)
+      return;
+    uint64_t stamps[2];
+    vkassert(vk.device.getQueryPoolResults(
+        queries, 2 * slot, 2, sizeof(stamps), stamps, sizeof(uint64_t),
+        vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait));
+    auto mask = valid_bits == 64 ? ~uint64_t(0)
+                                 : (uint64_t(1) << valid_bits) - 1;
+    ticks += (stamps[1] - stamps[0]) & mask;
+  };
+
+  // batch n signals sim_timeline with base + n + 1, so the gpu always has the
+  // next batch queued while the host records the one after
+  uint64_t base = vk.device.getSemaphoreCounterValue(vk.sim_timeline);
+  auto wait = [&](uint64_t value) {
+    value += base;
+    vkassert(vk.device.waitSemaphores({.semaphoreCount = 1,
+                                       .pSemaphores = &vk.sim_timeline,
+                                       .pValues = &value},
+                                      UINT64_MAX));
+  };
+  auto start = std::chrono::steady_clock::now();
+  uint64_t done = 0, batch = 0;
+  while (done < steps) {
+    auto count =
+        static_cast<unsigned>(std::min<uint64_t>(batch_size, steps - done));
+    auto slot = static_cast<uint32_t>(batch % frames_in_flight);
+    auto buffer = buffers[slot];
+    if (batch >= frames_in_flight) {
+      wait(batch + 1 - frames_in_flight);
+      readTimestamps(slot);
+    }
+
+    buffer.reset();
+    vk::CommandBufferBeginInfo info{};
+    vkassert(buffer.begin(&info));
+    if (queries) {
+      buffer.resetQueryPool(queries, 2 * slot, 2);
+      buffer.writeTimestamp(eTopOfPipe, queries, 2 * slot);
+    }
+    // the previous batch's steps have to land before this one's
+    computeBarrier(buffer, eComputeShader);
+    if (recorder)
+      recordSteps(vk, buffer, sim, count, dt, *recorder);
+    else
+      recordSteps(vk, buffer, sim, count, dt);
+    done += count;
+    if (done == steps) {
+      computeBarrier(buffer, eComputeShader);
+      recordReduce(vk, buffer, sim.descs[sim.parity], 0);
+    }
+    if (queries)
+      buffer.writeTimestamp(eBottomOfPipe, queries, 2 * slot + 1);
+    buffer.end();
+
+    // whatever was uploaded so far has to land before the steps read it
+    uint64_t uploads = staging.flush();
+    uint64_t signal_value = base + ++batch;
+    vk::TimelineSemaphoreSubmitInfo timeline{
+        .waitSemaphoreValueCount = 1,
+        .pWaitSemaphoreValues = &uploads,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &signal_value};
+    vk::PipelineStageFlags wait_stage = eComputeShader;
+    vk.queues.compute().submit(
+        vk::SubmitInfo{.pNext = &timeline,
+                       .waitSemaphoreCount = 1,
+                       .pWaitSemaphores = &staging.timeline,
+                       .pWaitDstStageMask = &wait_stage,
+                       .commandBufferCount = 1,
+                       .pCommandBuffers = &buffer,
+                       .signalSemaphoreCount = 1,
+                       .pSignalSemaphores = &vk.sim_timeline});
+    if (recorder)
+      recorder->submitted(signal_value);
+  }
+  wait(batch);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  for (uint64_t b = batch - std::min<uint64_t>(batch, frames_in_flight);
+       b < batch; b++)
+    readTimestamps(static_cast<uint32_t>(b % frames_in_flight));
+
+  GpuRun run{.steps = steps, .seconds = elapsed.count()};
+  if (queries)
+    run.gpu_seconds = ticks * double(period) * 1e-9;
+  return run;
+}
+
+GpuRun measureGpu(Context &context, const Options &options, Kernel kernel,
+                  double seconds) {
+  auto vk = Renderer(context, kernel);
+  auto staging = StagingRing(context, vk);
+  auto sim = createSimulation(context, vk, staging, nullptr,
+                              options.reorder_every);
+  auto warmup = stepGpu(context, vk, sim, staging, options.max_substeps,
+                        options.max_substeps, options.timestep);
+  auto rate = warmup.steps / std::max(warmup.seconds, 1e-6);
+  auto steps = static_cast<uint64_t>(std::ceil(rate * seconds));
+  return stepGpu(context, vk, sim, staging, std::max<uint64_t>(steps, 1),
+                 options.max_substeps, options.timestep);
+}
+
+int runHeadless(const Options &options, const Checkpoint *restore) {
+  auto context = Context(Headless{});
+  auto tuned = autotune(context, options);
+  world::constants.work_size = tuned.work_size;
+  auto vk = Renderer(context, tuned.kernel);
+  auto staging = StagingRing(context, vk);
+  auto sim = createSimulation(context, vk, staging, restore,
+                              options.reorder_every);
+  auto device = context.phys.getProperties().deviceName;
+  fmt::print("running {} steps of {} particles with the {} kernel in "
+             "workgroups of {} on {}\n",
+             options.steps, world::constants.obj_count, name(tuned.kernel),
+             tuned.work_size, device.data());
+  fmt::print("built pipelines in {:.1f} ms\n", vk.pipeline_ms);
+  fmt::print("{} bytes of state per particle\n", sim.layout.particleSize());
+  if (options.reorder_every != 0)
+    fmt::print("reordering the particles every {} steps\n",
+               options.reorder_every);
+
+  std::optional<Recorder> recorder;
+  if (!options.record.empty())
+    recorder.emplace(context, vk, options.record, options.record_every,
+                     options.record_quantum, options.timestep);
+
+  auto run = stepGpu(context, vk, sim, staging, options.steps,
+                     options.max_substeps, options.timestep,
+                     recorder ? &*recorder : nullptr);
+  report(options, run.seconds, sim.observables[0]);
+  if (recorder) {
+    recorder->drain();
+    auto stats = recorder->stats();
+    fmt::print("recorded {} frames to {}, {} dropped\n", stats.frames,
+               options.record, stats.dropped);
+  }
+  if (run.gpu_seconds)
+    fmt::print("gpu time {:.3f} ms/step\n",
+               *run.gpu_seconds * 1e3 / options.steps);
+  else
+    fmt::print("the compute queue has no timestamps\n");
+  if (sim.verlet) {
+    auto state = readVerletState(context, vk, sim);
+    fmt::print("built the neighbour lists with skin {} {} times\n",
+               world::constants.skin, state.builds);
+    if (state.overflows != 0)
+      fmt::print("warning: {} neighbour lists overflowed and lost partners, "
+                 "collisions were missed and momentum isn't conserved\n",
+                 state.overflows);
+  }
+  for (auto &heap : context.allocator->stats()) {
+    if (heap.blocks != 0)
+      fmt::print("{:.1f} of {:.1f} MiB used in {} blocks by {} buffers, "
+                 "fragmentation {:.2f}\n",
+                 heap.used / 1048576.0, heap.reserved / 1048576.0,
+                 heap.blocks, heap.allocations, heap.fragmentation());
+  }
+  vk.device.waitIdle();
+  if (!options.save.empty()) {
+    saveCheckpoint(options.save, context, vk, sim);
+    fmt::print("saved step {} to {}\n", sim.step, options.save);
+  }
+  return 0;
+}
+
+int runCpu(const Options &options, const Checkpoint *restore) {
+  auto engine =
+      CpuEngine(restore ? restore->world() : genWorld(), options.threads);
+  uint64_t step = restore ? restore->header().step : 0;
+  fmt::print("running {} steps of {} particles on {} threads with {}\n",
+             options.steps, world::constants.obj_count, engine.threads(),
+             engine.isa());
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < options.steps; i++) {
+    engine.step(options.timestep);
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  report(options, elapsed.count(), engine.observe());
+  if (!options.save.empty()) {
+    auto world = engine.world();
+    writeCheckpoint(options.save, step + options.steps, world.pos, world.vel,
+                    world.color);
+    fmt::print("saved step {} to {}\n", step + options.steps, options.save);
+  }
+  return 0;
+}
+
+int runEvents(const Options &options, const Checkpoint *restore) {
+  auto engine = EventEngine(restore ? restore->world() : genWorld());
+  uint64_t step = restore ? restore->header().step : 0;
+  auto seconds = options.steps * double(options.timestep);
+  fmt::print("simulating {} s, {} steps' worth, of {} particles event by "
+             "event\n",
+             seconds, options.steps, world::constants.obj_count);
+
+  auto start = std::chrono::steady_clock::now();
+  engine.advance(seconds);
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  report(options, elapsed.count(), engine.observe());
+  auto &stats = engine.stats();
+  fmt::print("{} collisions, {} wall bounces, {} cell crossings, {} stale "
+             "events\n",
+             stats.collisions, stats.bounces, stats.crossings, stats.stale);
+  if (!options.save.empty()) {
+    auto world = engine.world();
+    writeCheckpoint(options.save, step + options.steps, world.pos, world.vel,
+                    world.color);
+    fmt::print("saved step {} to {}\n", step + options.steps, options.save);
+  }
+  return 0;
+}
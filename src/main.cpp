@@ -1,6 +1,7 @@
 #include <SDL2/SDL_events.h>
 #include <SDL2/SDL_scancode.h>
 #include <SDL2/SDL_video.h>
+#include <algorithm>
 #include <array>
 #include <chrono>
 #include <cmath>
@@ -12,8 +13,10 @@
 #include <glm/ext/matrix_transform.hpp>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <iterator>
 #include <limits>
 #include <numeric>
+#include <optional>
 #include <ranges>
 #include <span>
 #include <stdexcept>
@@ -22,27 +25,29 @@
 #include <vulkan/vulkan.hpp>
 #include <vulkan/vulkan_to_string.hpp>
 
+#include "autotune.hpp"
+#include "bench.hpp"
 #include "buffer.hpp"
+#include "checkpoint.hpp"
 #include "constants.hpp"
 #include "context.hpp"
+#include "event_engine.hpp"
 #include "gui.hpp"
+#include "headless.hpp"
 #include "imgui.h"
+#include "options.hpp"
+#include "profiler.hpp"
+#include "recorder.hpp"
+#include "replay.hpp"
+#include "simulation.hpp"
+#include "staging.hpp"
 #include "ubo.hpp"
 #include "util/vkassert.hpp"
 #include "vertex.hpp"
 #include "win_setup.hpp"
+#include "world.hpp"
 
 namespace {
-struct WorldS {
-  constexpr static auto size = 256 * 20;
-  glm::vec2 pos[size];
-  glm::vec2 vel[size];
-  glm::vec4 color[size];
-};
-struct WorldOut {
-  constexpr static auto size = 256 * 20;
-  std::array<float, size> energy;
-};
 struct UpdateSwapchainException {};
 
 constexpr auto vertices = std::to_array<Vertex>({{{1, 0}},
@@ -106,17 +111,6 @@ constexpr auto indices = std::to_array<uint16_t>({
     0, 43, 44, 0, 44, 45, 0, 45, 46, 0, 46, 47, 0, 47, 48, 0, 48, 49,
 });
 
-template <typename T>
-concept contiguous = std::ranges::contiguous_range<T>;
-
-template <contiguous T> std::span<const uint8_t> bin(T in) {
-  return {reinterpret_cast<const uint8_t *>(in.data()),
-          in.size() * sizeof(in[0])};
-}
-template <typename T> std::span<const uint8_t> bin_view(T in) {
-  return {reinterpret_cast<const uint8_t *>(&in), sizeof(in)};
-}
-
 struct Position {
   float x = -1, y = 1;
   float zoom = 1;
@@ -217,9 +211,92 @@ void setScissorViewport(vk::Extent2D swapchain_extent,
       0, std::array{vk::Rect2D{.offset = {0, 0}, .extent = swapchain_extent}});
 }
 
+// what one frame in flight's render pass draws, a copy of the state the
+// simulation ended that frame on. the render pass reads it on the graphics
+// queue while the next frame's steps overwrite both world buffers
+struct Display {
+  Buffer buffer;
+  // the culling pass's output, the particles in view and the indirect draw
+  // covering them
+  Buffer visible, command;
+  // the splatting pass's, a count and an energy sum per cell of grid, which
+  // is the swapchain's size when the display was made
+  Buffer density;
+  vk::Extent2D grid;
+  vk::DescriptorSet desc;
+};
+
+// compacts the particles of display whose sprite is in view under constants
+// into its visible list and sets the instance count of its draw command, on
+// the graphics queue outside of the render pass
+void cull(Renderer &vk, vk::CommandBuffer buffer, Display &display,
+          const PushConstants &constants) {
+  using enum vk::PipelineStageFlagBits;
+  using enum vk::AccessFlagBits;
+  // the mesh stays inside the unit circle, the circle's edge fades out half
+  // a pixel past it
+  auto mesh = vk.sprite == Sprite::mesh;
+  auto command = vk::DrawIndexedIndirectCommand{
+      .indexCount = mesh ? static_cast<uint32_t>(indices.size()) : 3,
+      .instanceCount = 0,
+      .firstIndex = 0,
+      .vertexOffset = 0,
+      .firstInstance = 0};
+  buffer.updateBuffer(display.command.buffer, 0, sizeof(command), &command);
+  buffer.pipelineBarrier(
+      eTransfer, eComputeShader, {},
+      vk::MemoryBarrier{.srcAccessMask = eTransferWrite,
+                        .dstAccessMask = eShaderRead | eShaderWrite},
+      {}, {});
+
+  auto push = CullConstants{.transform = constants.transform,
+                            .reach = mesh ? world::radius
+                                          : 1.25f * world::radius};
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, vk.cull_pipe);
+  buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, vk.cull_layout,
+                            0, display.desc, {});
+  buffer.pushConstants(vk.cull_layout, vk::ShaderStageFlagBits::eCompute, 0,
+                       vk::ArrayProxy<const CullConstants>(1, &push));
+  buffer.dispatch(world::constants.groups(), 1, 1);
+  buffer.pipelineBarrier(
+      eComputeShader, eDrawIndirect | eVertexShader, {},
+      vk::MemoryBarrier{.srcAccessMask = eShaderWrite,
+                        .dstAccessMask = eIndirectCommandRead | eShaderRead},
+      {}, {});
+}
+
+// bins every particle of display in view into its density grid, in place of
+// cull when they're drawn as a density field
+void splatDensity(Renderer &vk, vk::CommandBuffer buffer, Display &display,
+                  const SplatConstants &constants) {
+  using enum vk::PipelineStageFlagBits;
+  using enum vk::AccessFlagBits;
+  buffer.fillBuffer(display.density.buffer, 0, VK_WHOLE_SIZE, 0);
+  buffer.pipelineBarrier(
+      eTransfer, eComputeShader, {},
+      vk::MemoryBarrier{.srcAccessMask = eTransferWrite,
+                        .dstAccessMask = eShaderRead | eShaderWrite},
+      {}, {});
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, vk.splat_pipe);
+  buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, vk.splat_layout,
+                            0, display.desc, {});
+  buffer.pushConstants(vk.splat_layout,
+                       vk::ShaderStageFlagBits::eCompute |
+                           vk::ShaderStageFlagBits::eFragment,
+                       0, vk::ArrayProxy<const SplatConstants>(1, &constants));
+  buffer.dispatch(world::constants.groups(), 1, 1);
+  buffer.pipelineBarrier(
+      eComputeShader, eFragmentShader, {},
+      vk::MemoryBarrier{.srcAccessMask = eShaderWrite,
+                        .dstAccessMask = eShaderRead},
+      {}, {});
+}
+
+// draws however many particles cull left in display's draw command, or
+// display's density grid if splat says to
 void render(Renderer &vk, vk::CommandBuffer buffer, int index, Buffer &vert,
-            Buffer &ind, vk::DescriptorSet world, int index_count,
-            PushConstants &constants) {
+            Buffer &ind, Display &display, PushConstants &constants,
+            const SplatConstants *splat, Profiler &profiler, uint32_t slot) {
   vk::ClearValue clearColor = {.color = {std::array{0.0f, 0.0f, 0.0f, 1.0f}}};
   buffer.beginRenderPass({.renderPass = vk.pass,
                           .framebuffer = vk.framebuffers[index],
@@ -227,27 +304,136 @@ void render(Renderer &vk, vk::CommandBuffer buffer, int index, Buffer &vert,
                           .clearValueCount = 1,
                           .pClearValues = &clearColor},
                          vk::SubpassContents::eInline);
+  setScissorViewport(vk.swapchain_extent, buffer);
+  if (splat) {
+    buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                        vk.splat_graphics_pipe);
+    buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                              vk.splat_layout, 0, display.desc, {});
+    buffer.pushConstants(vk.splat_layout,
+                         vk::ShaderStageFlagBits::eCompute |
+                             vk::ShaderStageFlagBits::eFragment,
+                         0, vk::ArrayProxy<const SplatConstants>(1, splat));
+    profiler.mark(buffer, slot, Profiler::particles);
+    profiler.beginStatistics(buffer, slot, false);
+    buffer.draw(3, 1, 0, 0);
+    profiler.endStatistics(buffer, slot, false);
+    profiler.mark(buffer, slot, Profiler::gui);
+    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), buffer);
+    profiler.mark(buffer, slot, Profiler::graphics_end);
+    buffer.endRenderPass();
+    return;
+  }
   buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, vk.graphics_pipe);
   buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, vk.layout, 0,
-                            world, {});
-  buffer.bindVertexBuffers(0, std::array{vert.buffer},
-                           std::array{vk::DeviceSize(0)});
-  buffer.bindIndexBuffer(ind.buffer, 0, vk::IndexType::eUint16);
-  setScissorViewport(vk.swapchain_extent, buffer);
+                            display.desc, {});
+  if (vk.sprite == Sprite::mesh) {
+    buffer.bindVertexBuffers(0, std::array{vert.buffer},
+                             std::array{vk::DeviceSize(0)});
+    buffer.bindIndexBuffer(ind.buffer, 0, vk::IndexType::eUint16);
+  }
   buffer.pushConstants(vk.layout, vk::ShaderStageFlagBits::eVertex, 0,
                        vk::ArrayProxy<const PushConstants>(1, &constants));
-  buffer.drawIndexed(indices.size(), index_count, 0, 0, 0);
+  profiler.mark(buffer, slot, Profiler::particles);
+  profiler.beginStatistics(buffer, slot, false);
+  // the non-indexed command is the indexed one's first four fields
+  if (vk.sprite == Sprite::mesh)
+    buffer.drawIndexedIndirect(display.command.buffer, 0, 1,
+                               sizeof(vk::DrawIndexedIndirectCommand));
+  else
+    buffer.drawIndirect(display.command.buffer, 0, 1,
+                        sizeof(vk::DrawIndirectCommand));
+  profiler.endStatistics(buffer, slot, false);
+  profiler.mark(buffer, slot, Profiler::gui);
   ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), buffer);
+  profiler.mark(buffer, slot, Profiler::graphics_end);
   buffer.endRenderPass();
 }
 
 vk::Result swapchain_acquire_result = vk::Result::eSuccess;
 
+// records and submits frame's simulation on the compute queue: steps steps,
+// captured into recorder if there is one, the reduction into slot and a copy
+// of the result into display, which is then released to the graphics queue
+// family
+void simulate(Renderer &c, vk::CommandBuffer buffer, uint64_t frame,
+              uint32_t slot, Simulation &sim, Display &display,
+              unsigned steps, float dt, Profiler &profiler,
+              StagingRing &staging, Recorder *recorder) {
+  using enum vk::PipelineStageFlagBits;
+  auto graphics = static_cast<uint32_t>(c.families.graphics);
+  auto compute = static_cast<uint32_t>(c.families.compute);
+
+  buffer.reset();
+  vk::CommandBufferBeginInfo info{};
+  vkassert(buffer.begin(&info));
+  profiler.beginCompute(buffer, slot);
+  profiler.mark(buffer, slot, Profiler::steps);
+  // display was last drawn frames_in_flight frames ago
+  if (frame >= frames_in_flight)
+    ownershipBarrier(buffer, display.buffer.buffer, graphics, compute,
+                     eTransfer, {}, eTransfer,
+                     vk::AccessFlagBits::eTransferWrite);
+  // the previous frame's steps have to land and its copy has to be done
+  // reading before the first step overwrites
+  computeBarrier(buffer, eComputeShader, eComputeShader | eTransfer);
+  profiler.beginStatistics(buffer, slot, true);
+  if (recorder)
+    recordSteps(c, buffer, sim, steps, dt, *recorder);
+  else
+    recordSteps(c, buffer, sim, steps, dt);
+  profiler.endStatistics(buffer, slot, true);
+  profiler.mark(buffer, slot, Profiler::reduce);
+  computeBarrier(buffer, eComputeShader | eTransfer);
+  recordReduce(c, buffer, sim.descs[sim.parity], slot);
+  buffer.copyBuffer(sim.world[sim.parity].buffer, display.buffer.buffer,
+                    vk::BufferCopy{0, 0, sim.layout.size});
+  profiler.mark(buffer, slot, Profiler::compute_end);
+  ownershipBarrier(buffer, display.buffer.buffer, compute, graphics, eTransfer,
+                   vk::AccessFlagBits::eTransferWrite, eBottomOfPipe, {});
+  buffer.end();
+
+  // uploads since the last frame go out with this one, the steps and the
+  // copy wait for them and nothing else does
+  vk::Semaphore wait_semaphores[] = {staging.timeline, c.draw_timeline};
+  uint64_t wait_values[] = {staging.flush(), frame + 1 - frames_in_flight};
+  vk::PipelineStageFlags wait_stages[] = {eComputeShader | eTransfer,
+                                          eTransfer};
+  uint64_t signal_value = frame + 1;
+  // the first frames in flight have no earlier render pass to wait for
+  uint32_t waits = frame >= frames_in_flight ? 2 : 1;
+  vk::TimelineSemaphoreSubmitInfo timeline{
+      .waitSemaphoreValueCount = waits,
+      .pWaitSemaphoreValues = wait_values,
+      .signalSemaphoreValueCount = 1,
+      .pSignalSemaphoreValues = &signal_value};
+  c.queues.compute().submit(vk::SubmitInfo{
+      .pNext = &timeline,
+      .waitSemaphoreCount = waits,
+      .pWaitSemaphores = wait_semaphores,
+      .pWaitDstStageMask = wait_stages,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &buffer,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &c.sim_timeline});
+  if (recorder)
+    recorder->submitted(signal_value);
+}
+
+// submits frame's simulation on the compute queue, then draws its result on
+// the graphics queue once it's done, as a density field if splat isn't null.
+// the graphics queue meanwhile still has the previous frame to finish, which
+// is what the simulation overlaps
 void draw(Renderer &c, vk::SwapchainKHR swapchain, vk::CommandBuffer buffer,
-          Buffer &vert, Buffer &ind, int instance_count,
-          PushConstants &constants, int index,
-          std::span<vk::DescriptorSet> world_descs) {
+          vk::CommandBuffer compute, Buffer &vert, Buffer &ind,
+          PushConstants &constants, const SplatConstants *splat, int index,
+          uint64_t frame,
+          Simulation &sim, Display &display, unsigned steps, float dt,
+          Profiler &profiler, StagingRing &staging, Recorder *recorder) {
+  using enum vk::PipelineStageFlagBits;
   vkassert(c.device.waitForFences(c.inflight_fen[index], true, UINT64_MAX));
+  // both halves of the frame that last used this slot are done now
+  profiler.collect(index);
 
   auto [result, imageIndex] = c.device.acquireNextImageKHR(
       swapchain, UINT64_MAX, c.image_available_sem[index]);
@@ -259,31 +445,53 @@ void draw(Renderer &c, vk::SwapchainKHR swapchain, vk::CommandBuffer buffer,
   }
   c.device.resetFences(c.inflight_fen[index]);
 
-  buffer.reset();
+  simulate(c, compute, frame, index, sim, display, steps, dt, profiler,
+           staging, recorder);
 
-  auto i = imageIndex % world_descs.size();
+  auto graphics_family = static_cast<uint32_t>(c.families.graphics);
+  auto compute_family = static_cast<uint32_t>(c.families.compute);
+  buffer.reset();
 
   vk::CommandBufferBeginInfo info{};
   vkassert(buffer.begin(&info));
-  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.compute_pipe);
-  buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, c.compute_layout,
-                            0, world_descs[i], {});
-
-  buffer.dispatch(world::object_count / 256 + 1, 1, 1);
-  render(c, buffer, imageIndex, vert, ind, world_descs[i], instance_count,
-         constants);
+  profiler.beginGraphics(buffer, index);
+  ownershipBarrier(buffer, display.buffer.buffer, compute_family,
+                   graphics_family, eVertexShader, {},
+                   eComputeShader | eVertexShader,
+                   vk::AccessFlagBits::eShaderRead);
+  profiler.mark(buffer, index, Profiler::cull);
+  if (splat)
+    splatDensity(c, buffer, display, *splat);
+  else
+    cull(c, buffer, display, constants);
+  render(c, buffer, imageIndex, vert, ind, display, constants, splat,
+         profiler, index);
+  ownershipBarrier(buffer, display.buffer.buffer, graphics_family,
+                   compute_family, eComputeShader | eVertexShader, {},
+                   eBottomOfPipe, {});
   buffer.end();
 
-  vk::Semaphore waitSemaphores[] = {c.image_available_sem[index]};
-  vk::PipelineStageFlags waitStages[] = {
-      vk::PipelineStageFlagBits::eColorAttachmentOutput};
-  vk::Semaphore signalSemaphores[] = {c.render_done_sem[index]};
-  std::array submit = {vk::SubmitInfo{.waitSemaphoreCount = 1,
+  // binary semaphores ignore their entry in the value arrays
+  vk::Semaphore waitSemaphores[] = {c.image_available_sem[index],
+                                    c.sim_timeline};
+  uint64_t waitValues[] = {0, frame + 1};
+  vk::PipelineStageFlags waitStages[] = {eColorAttachmentOutput,
+                                         eComputeShader | eVertexShader};
+  vk::Semaphore signalSemaphores[] = {c.render_done_sem[index],
+                                      c.draw_timeline};
+  uint64_t signalValues[] = {0, frame + 1};
+  vk::TimelineSemaphoreSubmitInfo timeline{.waitSemaphoreValueCount = 2,
+                                           .pWaitSemaphoreValues = waitValues,
+                                           .signalSemaphoreValueCount = 2,
+                                           .pSignalSemaphoreValues =
+                                               signalValues};
+  std::array submit = {vk::SubmitInfo{.pNext = &timeline,
+                                      .waitSemaphoreCount = 2,
                                       .pWaitSemaphores = waitSemaphores,
                                       .pWaitDstStageMask = waitStages,
                                       .commandBufferCount = 1,
                                       .pCommandBuffers = &buffer,
-                                      .signalSemaphoreCount = 1,
+                                      .signalSemaphoreCount = 2,
                                       .pSignalSemaphores = signalSemaphores}};
 
   c.queues.render().submit(submit, c.inflight_fen[index]);
@@ -296,43 +504,108 @@ void draw(Renderer &c, vk::SwapchainKHR swapchain, vk::CommandBuffer buffer,
                                          .pImageIndices = &imageIndex}));
 }
 
-Buffer createVertBuffer(Context &vk, Renderer &r) {
+// the mesh is written on the transfer queue and drawn on the graphics queue
+std::vector<uint32_t> meshFamilies(Context &vk) {
+  auto graphics = static_cast<uint32_t>(vk.indicies.graphics);
+  auto transfer = static_cast<uint32_t>(vk.indicies.transfer);
+  if (graphics == transfer)
+    return {graphics};
+  return {graphics, transfer};
+}
+
+Buffer createVertBuffer(Context &vk, StagingRing &staging) {
   using enum vk::BufferUsageFlagBits;
   using enum vk::MemoryPropertyFlagBits;
-  auto vert = Buffer(vk.device, vk.phys, vertices.size() * sizeof(vertices[0]),
-                     eVertexBuffer | eTransferDst, eDeviceLocal);
-  vert.write(vk.device, vk.phys, r, bin(vertices));
+  auto vert = Buffer(*vk.allocator, vertices.size() * sizeof(vertices[0]),
+                     eVertexBuffer | eTransferDst, eDeviceLocal,
+                     meshFamilies(vk));
+  staging.upload(vert.buffer, bin(vertices));
 
   return vert;
 }
 
-Buffer createIndBuffer(Context &vk, Renderer &r) {
+Buffer createIndBuffer(Context &vk, StagingRing &staging) {
   using enum vk::BufferUsageFlagBits;
   using enum vk::MemoryPropertyFlagBits;
-  auto vert = Buffer(vk.device, vk.phys, indices.size() * sizeof(indices[0]),
-                     eIndexBuffer | eTransferDst, eDeviceLocal);
-  vert.write(vk.device, vk.phys, r, bin(indices));
+  auto vert = Buffer(*vk.allocator, indices.size() * sizeof(indices[0]),
+                     eIndexBuffer | eTransferDst, eDeviceLocal,
+                     meshFamilies(vk));
+  staging.upload(vert.buffer, bin(indices));
 
   return vert;
 }
 
-std::vector<vk::DescriptorSet> createDescs(Renderer &vk, vk::Buffer world,
-                                           vk::Buffer out, uint32_t binding) {
-  auto descs = vk.getDescriptors(frames_in_flight, vk.compute_desc_layout);
-  for (size_t i = 0; i < frames_in_flight; i++) {
-    auto buffer_info = std::to_array<vk::DescriptorBufferInfo>(
-        {{.buffer = world, .offset = 0, .range = VK_WHOLE_SIZE},
-         {.buffer = out, .offset = 0, .range = VK_WHOLE_SIZE}});
+// one display buffer per frame in flight, only ever owned by one queue family
+// at a time and handed back and forth with ownershipBarrier
+std::vector<Display> createDisplays(Context &context, Renderer &vk,
+                                    const WorldLayout &layout) {
+  using enum vk::BufferUsageFlagBits;
+  using enum vk::MemoryPropertyFlagBits;
+  auto descs = vk.getDescriptors(frames_in_flight, vk.descriptor_layout);
+  auto grid = vk.swapchain_extent;
+  std::vector<Display> displays;
+  for (auto desc : descs) {
+    auto display = Display{
+        .buffer = Buffer(*context.allocator, layout.size,
+                         eStorageBuffer | eTransferDst, eDeviceLocal),
+        .visible = Buffer(*context.allocator, layout.count * sizeof(uint32_t),
+                          eStorageBuffer, eDeviceLocal),
+        .command = Buffer(*context.allocator,
+                          sizeof(vk::DrawIndexedIndirectCommand),
+                          eStorageBuffer | eIndirectBuffer | eTransferDst,
+                          eDeviceLocal),
+        .density = Buffer(*context.allocator,
+                          2 * sizeof(uint32_t) * grid.width * grid.height,
+                          eStorageBuffer | eTransferDst, eDeviceLocal),
+        .grid = grid,
+        .desc = desc};
+    auto world_info = layout.describe(display.buffer.buffer);
+    auto view_info = std::to_array<vk::DescriptorBufferInfo>(
+        {{.buffer = display.visible.buffer,
+          .offset = 0,
+          .range = VK_WHOLE_SIZE},
+         {.buffer = display.command.buffer,
+          .offset = 0,
+          .range = VK_WHOLE_SIZE},
+         {.buffer = display.density.buffer,
+          .offset = 0,
+          .range = VK_WHOLE_SIZE}});
     vk.device.updateDescriptorSets(
-        {{.dstSet = descs[i],
-          .dstBinding = binding,
+        {{.dstSet = desc,
+          .dstBinding = 0,
           .dstArrayElement = 0,
-          .descriptorCount = buffer_info.size(),
+          .descriptorCount = static_cast<uint32_t>(world_info.size()),
           .descriptorType = vk::DescriptorType::eStorageBuffer,
-          .pBufferInfo = buffer_info.data()}},
+          .pBufferInfo = world_info.data()},
+         {.dstSet = desc,
+          .dstBinding = 11,
+          .dstArrayElement = 0,
+          .descriptorCount = static_cast<uint32_t>(view_info.size()),
+          .descriptorType = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo = view_info.data()}},
         {});
+    displays.push_back(std::move(display));
+  }
+  return displays;
+}
+
+// every heap something was allocated from, with how well it's packed
+void showMemory(const Allocator &allocator) {
+  if (!ImGui::CollapsingHeader("device memory"))
+    return;
+  auto stats = allocator.stats();
+  for (size_t i = 0; i < stats.size(); i++) {
+    auto &heap = stats[i];
+    if (heap.blocks == 0)
+      continue;
+    auto local = heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal;
+    ImGui::Text("heap %zu (%s): %.1f of %.1f MiB used in %u blocks, %u "
+                "buffers",
+                i, local ? "device" : "host", heap.used / 1048576.0,
+                heap.reserved / 1048576.0, heap.blocks, heap.allocations);
+    ImGui::Text("  fragmentation %.2f, largest free %.1f MiB",
+                heap.fragmentation(), heap.largest_free / 1048576.0);
   }
-  return descs;
 }
 
 void updateSwapchain(Context &context, Renderer &vk) {
@@ -340,75 +613,111 @@ void updateSwapchain(Context &context, Renderer &vk) {
   vk.recreateFramebuffers(context);
 }
 
-int signrand() { return std::rand() * (std::rand() % 2 ? 1 : -1); }
-WorldS genWorld() {
-  WorldS world;
-  srand(std::time(nullptr));
-  float x = 0, y = 0;
-  for (auto &s : std::span(world.pos).subspan(0, world::object_count)) {
-    s = {x, y};
-    x += world::max_x / std::sqrt(world::object_count);
-    if (x > world::max_x - world::radius) {
-      x = 0;
-      y += world::max_y / std::sqrt(world::object_count);
-    }
-  }
-  world.pos[0] = {6.8, 9};
-  world.pos[1] = {5, 5};
-  for (auto &v : std::span(world.vel).subspan(0, world::object_count)) {
-    v = {2 * world::delta.count() * signrand() / float(RAND_MAX),
-         2 * world::delta.count() * signrand() / float(RAND_MAX)};
-  }
-  world.vel[0] = {0, -world::delta.count()};
-  world.vel[1] = {0, world::delta.count()};
-  for (auto &c : std::span(world.color).subspan(0, world::object_count)) {
-    c = glm::vec4(0.2, 0.2, 0.2, 0.2);
-  }
-  return world;
-}
-
 } // namespace
 
-int main() {
+int main(int argc, char **argv) {
   using namespace world;
+  auto options = Options::parse(argc, argv);
+  // a restored world brings its own size, which the pipelines are
+  // specialized on
+  std::optional<Checkpoint> restore;
+  std::optional<Replay> replay;
+  if (!options.replay.empty()) {
+    replay.emplace(options.replay);
+    auto &header = replay->header();
+    configure(header.count, header.max_x, header.max_y);
+    replay->speed = options.speed;
+  } else if (!options.restore.empty()) {
+    restore.emplace(options.restore);
+    auto &header = restore->header();
+    configure(header.count, header.max_x, header.max_y);
+  } else {
+    configure(options.count);
+  }
+  constants.work_size = options.work_size;
+  constants.half_velocity = options.half_velocity;
+  constants.skin = options.skin;
+  auto *restored = restore ? &*restore : nullptr;
+  if (options.engine == Engine::cpu)
+    return runCpu(options, restored);
+  if (options.engine == Engine::events && options.headless)
+    return runEvents(options, restored);
+  if (options.bench)
+    return runBench(options);
+  if (options.headless)
+    return runHeadless(options, restored);
   auto context = Context(Window("triangles!", {.width = 1000, .height = 600}));
-  auto vk = Renderer(context);
+  // neither a replay nor the event engine steps the simulation, there's
+  // nothing to tune
+  if (!replay && options.engine == Engine::gpu) {
+    auto tuned = autotune(context, options);
+    options.kernel = tuned.kernel;
+    constants.work_size = tuned.work_size;
+  }
+  auto vk = Renderer(context, options.kernel, options.sprite);
+  fmt::print("built pipelines in {:.1f} ms\n", vk.pipeline_ms);
   auto gui = GUI(context, vk);
   auto cmd_buffers = vk.getCommands(frames_in_flight);
-  auto vert = createVertBuffer(context, vk);
-  auto ind = createIndBuffer(context, vk);
-  using enum vk::BufferUsageFlagBits;
-  auto world_buf = Buffer(context.device, context.phys, sizeof(WorldS),
-                          eStorageBuffer | eTransferDst,
-                          vk::MemoryPropertyFlagBits::eDeviceLocal);
-  auto w_out = MappedBuffer<WorldOut>(context.device, context.phys,
-                                      eStorageBuffer | eTransferDst);
-
-  vk.execute_immediately([&](vk::CommandBuffer cmd) {
-    static_assert(sizeof(float) == sizeof(uint32_t),
-                  "size of float and uint32 don't match");
-    cmd.fillBuffer(
-        world_buf.buffer, 0, vk::WholeSize,
-        std::bit_cast<uint32_t>(std::numeric_limits<float>::quiet_NaN()));
-    cmd.fillBuffer(w_out.buffer.buffer, 0, vk::WholeSize,
-                   std::bit_cast<uint32_t>(0.0f));
-  });
-
-  auto world_desc = createDescs(vk, world_buf.buffer, w_out.buffer.buffer, 0);
-  auto beginning = genWorld();
-  world_buf.write(context.device, context.phys, vk, bin_view(beginning));
+  auto compute_buffers = vk.getComputeCommands(frames_in_flight);
+  // the event engine keeps the world on the host and the gpu only draws it
+  std::optional<EventEngine> events;
+  if (options.engine == Engine::events)
+    events.emplace(restore ? restore->world() : genWorld());
+  // a replay or the event engine uploads a frame every frame, the ring holds
+  // two so the next never waits for the last
+  auto frame_bytes = 2 *
+                     (2 * sizeof(glm::vec2) + sizeof(uint32_t)) *
+                     constants.obj_count;
+  auto staging = StagingRing(
+      context, vk,
+      replay || events
+          ? std::max<vk::DeviceSize>(StagingRing::default_size, frame_bytes)
+          : StagingRing::default_size);
+  auto vert = createVertBuffer(context, staging);
+  auto ind = createIndBuffer(context, staging);
+  auto sim = createSimulation(context, vk, staging, restored,
+                              options.reorder_every);
+  restore.reset();
+  auto displays = createDisplays(context, vk, sim.layout);
   auto pos = Position();
-
-  vk.queues.mem().waitIdle();
+  auto profiler = Profiler(context, vk, options.pipeline_statistics);
+  std::optional<Recorder> recorder;
+  if (!options.record.empty())
+    recorder.emplace(context, vk, options.record, options.record_every,
+                     options.record_quantum, options.timestep);
+
+  // the draw doesn't wait on the staging timeline, so the mesh has to be
+  // there before the first one. the simulation waits on it by itself
+  staging.wait(staging.flush());
+  if (replay) {
+    // frames only carry positions and velocities, both worlds keep the
+    // generated colors
+    vk.execute_immediately([&](vk::CommandBuffer cmd) {
+      cmd.copyBuffer(sim.world[0].buffer, sim.world[1].buffer,
+                     vk::BufferCopy{0, 0, sim.layout.size});
+    });
+  }
+  // the frame a replayed frame was last uploaded for, a frame the swapchain
+  // threw out is retried without uploading into the other world again
+  uint64_t replayed = UINT64_MAX;
+  // the same for the event engine's world, whose clock starts at the
+  // restored step
+  uint64_t fed = UINT64_MAX;
+  auto first_step = sim.step;
   int curr = 0;
+  // frames submitted so far, the timeline semaphores count in these
+  uint64_t frame = 0;
 
   FTime total_time{};
   unsigned frames{};
   bool resized = false;
   auto prev = std::chrono::high_resolution_clock::now();
   int fps = 0;
-  WorldOut out;
-  while (!processInput(context.window, resized, pos)) {
+  // simulated time owed to the world, paid off in whole steps every frame
+  float accumulator = 0;
+  // what the gpu reduced frames_in_flight frames ago
+  Observables observed{};
+  while (!processInput(*context.window, resized, pos)) {
     auto transform = PushConstants{glm::translate(
         glm::scale(glm::mat4(1.0), glm::vec3(pos.zoom)), {-pos.x, pos.y, 0})};
     auto now = std::chrono::high_resolution_clock::now();
@@ -421,23 +730,115 @@ int main() {
     }
 
     total_time += dt;
-    vk.queues.render().waitIdle();
-    w_out.read(&out);
+    accumulator += dt.count() * options.speed;
+    auto steps = static_cast<unsigned>(accumulator / options.timestep);
+    if (replay || events) {
+      if (replay)
+        replay->advance(dt.count());
+      accumulator = 0;
+      steps = 0;
+    }
+    if (steps > options.max_substeps) {
+      // the gpu can't keep up, drop the backlog rather than let it grow
+      steps = options.max_substeps;
+      accumulator = 0;
+    } else {
+      accumulator -= steps * options.timestep;
+    }
+    // only this slot's simulation has to be finished, the newer frame and
+    // the rendering keep running
+    if (frame >= frames_in_flight) {
+      uint64_t value = frame + 1 - frames_in_flight;
+      vkassert(vk.device.waitSemaphores(
+          {.semaphoreCount = 1,
+           .pSemaphores = &vk.sim_timeline,
+           .pValues = &value},
+          UINT64_MAX));
+    }
+    observed = sim.observables[curr];
+    // with two frames in flight the frame that last read the world the
+    // replay uploads into is the one just waited for
+    static_assert(frames_in_flight == 2);
+    if (replay && replayed != frame && replay->upload(staging, sim))
+      replayed = frame;
+    if (events && fed != frame) {
+      // the same cap on the backlog as max_substeps puts on stepping
+      events->advance(std::min(dt.count() * options.speed,
+                               options.max_substeps * options.timestep));
+      auto world = events->world();
+      auto target = 1 - sim.parity;
+      auto buffer = sim.world[target].buffer;
+      staging.upload(buffer, bin(world.pos), sim.layout.pos);
+      uploadVelocities(staging, buffer, sim.layout, world.vel);
+      staging.upload(buffer, bin(world.color), sim.layout.color);
+      sim.parity = target;
+      sim.step = first_step +
+                 static_cast<uint64_t>(events->time() / options.timestep);
+      // the reduction sees no steps and so no collisions
+      observed = events->observe();
+      fed = frame;
+    }
+    // pixels across a particle, the view is stretched to the window so the
+    // narrower axis decides
+    auto extent = vk.swapchain_extent;
+    auto diameter = radius * std::abs(pos.zoom) *
+                    std::min(screen_scale.width * extent.width,
+                             screen_scale.height * extent.height);
+    std::optional<SplatConstants> splat;
+    if (diameter < options.splat_below) {
+      // the hue is relative to the mean energy, which keeps its contrast
+      // however hot the world runs
+      auto reference = std::max(observed.kinetic / constants.obj_count,
+                                std::numeric_limits<float>::min());
+      auto &grid = displays[curr].grid;
+      splat = SplatConstants{
+          .transform = transform.transform,
+          .grid = {grid.width, grid.height},
+          .viewport = {static_cast<float>(extent.width),
+                       static_cast<float>(extent.height)},
+          .energy_scale = 64 / reference,
+          .reference = reference};
+    }
     try {
       ImGui_ImplVulkan_NewFrame();
-      ImGui_ImplSDL2_NewFrame(context.window.handle);
+      ImGui_ImplSDL2_NewFrame(context.window->handle);
 
       ImGui::NewFrame();
       ImGui::Text("fps: %i", fps);
+      ImGui::Text("kernel: %s in workgroups of %u, %u particles as %s",
+                  name(options.kernel).data(), constants.work_size,
+                  constants.obj_count,
+                  splat ? "density" : name(options.sprite).data());
       ImGui::Text("pos: (%f, %f)", pos.x, pos.y);
       ImGui::Text("scaling: %f", pos.zoom);
-      float energy = std::accumulate(
-          out.energy.begin(), out.energy.begin() + world::object_count, 0.0);
-      ImGui::Text("energy: %f", energy);
+      ImGui::Text("steps: %u per frame of %f s", steps, options.timestep);
+      ImGui::Text("energy: %f", observed.kinetic);
+      ImGui::Text("momentum: (%f, %f)", observed.momentum.x,
+                  observed.momentum.y);
+      ImGui::Text("max speed: %f", observed.max_speed);
+      ImGui::Text("collisions: %u", observed.collisions);
+      if (events) {
+        auto &stats = events->stats();
+        ImGui::Text("events: %llu collisions, %llu bounces, %llu crossings, "
+                    "%llu stale",
+                    static_cast<unsigned long long>(stats.collisions),
+                    static_cast<unsigned long long>(stats.bounces),
+                    static_cast<unsigned long long>(stats.crossings),
+                    static_cast<unsigned long long>(stats.stale));
+      }
+      profiler.show();
+      showMemory(*context.allocator);
+      if (recorder)
+        recorder->show();
+      if (replay)
+        replay->show();
       ImGui::EndFrame();
       ImGui::Render();
-      draw(vk, context.swapchain, cmd_buffers[curr], vert, ind, object_count,
-           transform, curr, world_desc);
+      draw(vk, context.swapchain, cmd_buffers[curr], compute_buffers[curr],
+           vert, ind, transform, splat ? &*splat : nullptr, curr, frame,
+           sim, displays[curr], steps, options.timestep, profiler, staging,
+           recorder ? &*recorder : nullptr);
+      frame++;
     } catch (UpdateSwapchainException e) {
       resized = true;
     }
@@ -445,15 +846,14 @@ int main() {
       updateSwapchain(context, vk);
       resized = false;
       int width, height;
-      SDL_GetWindowSize(context.window.handle, &width, &height);
+      SDL_GetWindowSize(context.window->handle, &width, &height);
       while (width == 0 && height == 0) {
-        processInput(context.window, resized, pos);
+        processInput(*context.window, resized, pos);
       }
     }
 
-    curr++;
-    if (curr >= frames_in_flight)
-      curr = 0;
+    // a frame the swapchain threw out is retried in the same slot
+    curr = frame % frames_in_flight;
     prev = now;
     frames++;
     if (total_time > FTime(1)) {
@@ -463,5 +863,9 @@ int main() {
     }
   }
   vk.device.waitIdle();
+  if (!options.save.empty()) {
+    saveCheckpoint(options.save, context, vk, sim);
+    fmt::print("saved step {} to {}\n", sim.step, options.save);
+  }
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "options.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <fmt/core.h>
+#include <fmt/ranges.h>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace {
+template <typename T> T number(std::string_view flag, std::string_view arg) {
+  T result{};
+  auto [end, err] = std::from_chars(arg.data(), arg.data() + arg.size(), result);
+  if (err != std::errc{} || end != arg.data() + arg.size())
+    throw std::invalid_argument(
+        fmt::format("{} expects a number, got '{}'", flag, arg));
+  return result;
+}
+
+Kernel kernelArg(std::string_view arg) {
+  if (auto kernel = parseKernel(arg))
+    return *kernel;
+  throw std::invalid_argument(
+      fmt::format("unknown kernel '{}', expected one of {}", arg,
+                  fmt::join(kernel_names, ", ")));
+}
+
+// comma separated list of whatever parse makes of each item
+template <typename F> auto list(std::string_view arg, F &&parse) {
+  std::vector<decltype(parse(arg))> result;
+  while (true) {
+    auto comma = arg.find(',');
+    result.push_back(parse(arg.substr(0, comma)));
+    if (comma == std::string_view::npos)
+      return result;
+    arg.remove_prefix(comma + 1);
+  }
+}
+} // namespace
+
+Options Options::parse(int argc, char **argv) {
+  Options o;
+  for (int i = 1; i < argc; i++) {
+    auto flag = std::string_view(argv[i]);
+    auto value = [&]() {
+      if (i + 1 >= argc)
+        throw std::invalid_argument(fmt::format("{} expects a value", flag));
+      return std::string_view(argv[++i]);
+    };
+    if (flag == "-n" || flag == "--count") {
+      o.count = number<uint32_t>(flag, value());
+    } else if (flag == "--timestep") {
+      o.timestep = number<float>(flag, value());
+    } else if (flag == "--speed") {
+      o.speed = number<float>(flag, value());
+    } else if (flag == "--workgroup") {
+      o.work_size = number<uint32_t>(flag, value());
+      o.work_size_given = true;
+    } else if (flag == "--tune") {
+      auto arg = value();
+      if (auto tune = parseTune(arg)) {
+        o.tune = *tune;
+      } else {
+        throw std::invalid_argument(
+            fmt::format("unknown tuning '{}', expected one of {}", arg,
+                        fmt::join(tune_names, ", ")));
+      }
+    } else if (flag == "--skin") {
+      o.skin = number<float>(flag, value());
+    } else if (flag == "--half-velocity") {
+      o.half_velocity = true;
+    } else if (flag == "--max-substeps") {
+      o.max_substeps = number<uint32_t>(flag, value());
+    } else if (flag == "--sprite") {
+      auto arg = value();
+      if (auto sprite = parseSprite(arg)) {
+        o.sprite = *sprite;
+      } else {
+        throw std::invalid_argument(
+            fmt::format("unknown sprite '{}', expected one of {}", arg,
+                        fmt::join(sprite_names, ", ")));
+      }
+    } else if (flag == "--reorder-every") {
+      o.reorder_every = number<uint32_t>(flag, value());
+    } else if (flag == "--splat-below") {
+      o.splat_below = number<float>(flag, value());
+    } else if (flag == "-e" || flag == "--engine") {
+      auto arg = value();
+      if (auto engine = parseEngine(arg)) {
+        o.engine = *engine;
+      } else {
+        throw std::invalid_argument(
+            fmt::format("unknown engine '{}', expected one of {}", arg,
+                        fmt::join(engine_names, ", ")));
+      }
+    } else if (flag == "-j" || flag == "--threads") {
+      o.threads = number<unsigned>(flag, value());
+    } else if (flag == "--restore") {
+      o.restore = value();
+    } else if (flag == "--save") {
+      o.save = value();
+    } else if (flag == "--record") {
+      o.record = value();
+    } else if (flag == "--record-every") {
+      o.record_every = number<uint32_t>(flag, value());
+    } else if (flag == "--record-quantum") {
+      o.record_quantum = number<float>(flag, value());
+    } else if (flag == "--replay") {
+      o.replay = value();
+    } else if (flag == "--pipeline-stats") {
+      o.pipeline_statistics = true;
+    } else if (flag == "--headless") {
+      o.headless = true;
+    } else if (flag == "--steps") {
+      o.steps = number<uint64_t>(flag, value());
+    } else if (flag == "-k" || flag == "--kernel") {
+      o.kernel = kernelArg(value());
+      o.kernel_given = true;
+    } else if (flag == "--bench") {
+      o.bench = true;
+    } else if (flag == "-o" || flag == "--output") {
+      o.output = value();
+    } else if (flag == "--counts") {
+      o.counts =
+          list(value(), [&](auto s) { return number<uint32_t>(flag, s); });
+    } else if (flag == "--kernels") {
+      o.kernels = list(value(), kernelArg);
+    } else if (flag == "--workgroups") {
+      o.work_sizes =
+          list(value(), [&](auto s) { return number<uint32_t>(flag, s); });
+    } else {
+      throw std::invalid_argument(fmt::format("unknown option '{}'", flag));
+    }
+  }
+  if (o.count < 2)
+    throw std::invalid_argument("need at least 2 particles");
+  if (o.work_size == 0 || std::ranges::count(o.work_sizes, 0u) != 0)
+    throw std::invalid_argument("workgroup sizes must be positive");
+  if (std::ranges::any_of(o.counts, [](auto n) { return n < 2; }))
+    throw std::invalid_argument("need at least 2 particles");
+  if (!(o.timestep > 0) || !(o.speed >= 0) || o.max_substeps == 0 ||
+      o.steps == 0)
+    throw std::invalid_argument("timestep, max substeps and steps must be "
+                                "positive, speed non-negative");
+  if (!(o.skin > 0) || o.skin > world::radius)
+    throw std::invalid_argument(fmt::format(
+        "skin has to be positive and at most the radius {}", world::radius));
+  if (!(o.splat_below >= 0))
+    throw std::invalid_argument("splat below can't be negative");
+  if (o.record_every == 0 || !(o.record_quantum > 0))
+    throw std::invalid_argument("record every and quantum must be positive");
+  if (o.bench && !o.restore.empty())
+    throw std::invalid_argument("the benchmark generates its own worlds");
+  if (o.bench && o.engine != Engine::gpu)
+    throw std::invalid_argument("the benchmark only sweeps the gpu kernels");
+  if (o.engine == Engine::events && !o.record.empty())
+    throw std::invalid_argument("the event engine can't record");
+  if (!o.replay.empty() &&
+      (o.headless || o.bench || o.engine != Engine::gpu ||
+       !o.restore.empty() || !o.record.empty()))
+    throw std::invalid_argument("replay only plays back into the window");
+  return o;
+}
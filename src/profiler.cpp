@@ -0,0 +1,198 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <imgui/imgui.h>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "context.hpp"
+
+namespace {
+using enum vk::QueryPipelineStatisticFlagBits;
+constexpr auto compute_statistics = eComputeShaderInvocations;
+// results come back in the order of the bits
+constexpr auto graphics_statistics =
+    eVertexShaderInvocations | eClippingPrimitives | eFragmentShaderInvocations;
+
+constexpr std::array pass_names = {"steps", "reduce and copy", "cull or splat",
+                                   "particles", "imgui"};
+
+uint64_t timestampMask(Context &context, int family) {
+  auto bits = context.phys.getQueueFamilyProperties()[family]
+                  .timestampValidBits;
+  if (bits == 0)
+    return 0;
+  return bits == 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+}
+
+// the value below which fraction of the samples lie
+float percentile(std::vector<float> samples, float fraction) {
+  auto nth = samples.begin() + static_cast<ptrdiff_t>(
+                                   fraction * (samples.size() - 1));
+  std::nth_element(samples.begin(), nth, samples.end());
+  return *nth;
+}
+
+// the first mark goes in before anything ran, every later one after all of
+// the work before it finished
+vk::PipelineStageFlagBits stage(uint32_t mark) {
+  return mark == 0 ? vk::PipelineStageFlagBits::eTopOfPipe
+                   : vk::PipelineStageFlagBits::eBottomOfPipe;
+}
+} // namespace
+
+Profiler::Profiler(Context &context, Renderer &vk, bool statistics)
+    : device(vk.device),
+      period(context.phys.getProperties().limits.timestampPeriod) {
+  auto timestamps = [&](Pool &pool, int family, uint32_t marks) {
+    pool.mask = timestampMask(context, family);
+    pool.per_slot = marks;
+    if (pool.mask)
+      pool.pool = device.createQueryPool(
+          {.queryType = vk::QueryType::eTimestamp,
+           .queryCount = marks * uint32_t(frames_in_flight)});
+  };
+  // the end marks are marks too
+  timestamps(compute_time, vk.families.compute, compute_end + 1);
+  timestamps(graphics_time, vk.families.graphics, graphics_end + 1);
+
+  if (statistics && context.features.pipelineStatisticsQuery) {
+    auto stats = [&](Pool &pool, vk::QueryPipelineStatisticFlags flags) {
+      pool.per_slot = 1;
+      pool.pool = device.createQueryPool(
+          {.queryType = vk::QueryType::ePipelineStatistics,
+           .queryCount = uint32_t(frames_in_flight),
+           .pipelineStatistics = flags});
+    };
+    stats(compute_stats, compute_statistics);
+    stats(graphics_stats, graphics_statistics);
+  }
+}
+
+Profiler::~Profiler() {
+  for (auto *pool :
+       {&compute_time, &graphics_time, &compute_stats, &graphics_stats})
+    device.destroyQueryPool(pool->pool);
+}
+
+void Profiler::beginCompute(vk::CommandBuffer buffer, uint32_t slot) {
+  for (auto *pool : {&compute_time, &compute_stats})
+    if (pool->pool)
+      buffer.resetQueryPool(pool->pool, slot * pool->per_slot,
+                            pool->per_slot);
+  pending[slot] = true;
+}
+
+void Profiler::beginGraphics(vk::CommandBuffer buffer, uint32_t slot) {
+  for (auto *pool : {&graphics_time, &graphics_stats})
+    if (pool->pool)
+      buffer.resetQueryPool(pool->pool, slot * pool->per_slot,
+                            pool->per_slot);
+}
+
+void Profiler::mark(vk::CommandBuffer buffer, uint32_t slot, Compute at) {
+  if (compute_time.pool)
+    buffer.writeTimestamp(stage(at), compute_time.pool,
+                          slot * compute_time.per_slot + at);
+}
+
+void Profiler::mark(vk::CommandBuffer buffer, uint32_t slot, Graphics at) {
+  if (graphics_time.pool)
+    buffer.writeTimestamp(stage(at), graphics_time.pool,
+                          slot * graphics_time.per_slot + at);
+}
+
+void Profiler::beginStatistics(vk::CommandBuffer buffer, uint32_t slot,
+                               bool compute) {
+  auto &pool = compute ? compute_stats : graphics_stats;
+  if (pool.pool)
+    buffer.beginQuery(pool.pool, slot, {});
+}
+
+void Profiler::endStatistics(vk::CommandBuffer buffer, uint32_t slot,
+                             bool compute) {
+  auto &pool = compute ? compute_stats : graphics_stats;
+  if (pool.pool)
+    buffer.endQuery(pool.pool, slot);
+}
+
+void Profiler::read(Pool &pool, uint32_t slot, size_t first_pass) {
+  std::array<uint64_t, std::max<size_t>(compute_end, graphics_end) + 1>
+      stamps;
+  if (!pool.pool ||
+      device.getQueryPoolResults(pool.pool, slot * pool.per_slot,
+                                 pool.per_slot,
+                                 pool.per_slot * sizeof(uint64_t),
+                                 stamps.data(), sizeof(uint64_t),
+                                 vk::QueryResultFlagBits::e64) !=
+          vk::Result::eSuccess)
+    return;
+  for (uint32_t i = 0; i + 1 < pool.per_slot; i++) {
+    auto ticks = (stamps[i + 1] - stamps[i]) & pool.mask;
+    passes[first_pass + i].ms[head] = float(ticks * double(period) * 1e-6);
+  }
+}
+
+void Profiler::collect(uint32_t slot) {
+  if (!pending[slot])
+    return;
+  pending[slot] = false;
+  read(compute_time, slot, 0);
+  read(graphics_time, slot, compute_end);
+  head = (head + 1) % history;
+  filled = std::min(filled + 1, history);
+
+  if (!compute_stats.pool)
+    return;
+  std::array<uint64_t, 4> counts;
+  auto flags = vk::QueryResultFlagBits::e64;
+  if (device.getQueryPoolResults(compute_stats.pool, slot, 1,
+                                 sizeof(uint64_t), counts.data(),
+                                 sizeof(uint64_t), flags) ==
+          vk::Result::eSuccess &&
+      device.getQueryPoolResults(graphics_stats.pool, slot, 1,
+                                 3 * sizeof(uint64_t), counts.data() + 1,
+                                 3 * sizeof(uint64_t), flags) ==
+          vk::Result::eSuccess)
+    statistics = counts;
+}
+
+void Profiler::show() {
+  if (!ImGui::CollapsingHeader("gpu profiler"))
+    return;
+  if (filled == 0) {
+    ImGui::Text("no frames yet");
+    return;
+  }
+  // the history is a ring, the plot starts at its oldest sample
+  auto offset = static_cast<int>(filled < history ? 0 : head);
+  std::vector<float> samples;
+  for (size_t p = 0; p < pass_count; p++) {
+    bool timed = p < compute_end ? bool(compute_time.pool)
+                                 : bool(graphics_time.pool);
+    if (!timed) {
+      ImGui::Text("%s: no timestamps on this queue", pass_names[p]);
+      continue;
+    }
+    auto &ms = passes[p].ms;
+    samples.assign(ms.begin(), ms.begin() + filled);
+    ImGui::Text("%s: p50 %.3f p95 %.3f p99 %.3f ms", pass_names[p],
+                percentile(samples, 0.5), percentile(samples, 0.95),
+                percentile(samples, 0.99));
+    ImGui::PushID(static_cast<int>(p));
+    ImGui::PlotLines("", ms.data(), static_cast<int>(filled), offset,
+                     nullptr, 0, FLT_MAX, ImVec2(0, 40));
+    ImGui::PopID();
+  }
+  if (statistics) {
+    auto &[compute, vertex, clipped, fragment] = *statistics;
+    ImGui::Text("compute invocations: %llu", (unsigned long long)compute);
+    ImGui::Text("vertex invocations: %llu", (unsigned long long)vertex);
+    ImGui::Text("clipped primitives: %llu", (unsigned long long)clipped);
+    ImGui::Text("fragment invocations: %llu", (unsigned long long)fragment);
+  }
+}
@@ -0,0 +1,238 @@
+#include "recorder.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fmt/core.h>
+#include <stdexcept>
+
+#include "constants.hpp"
+#include "imgui.h"
+#include "util/vkassert.hpp"
+
+namespace {
+// cached memory makes the encoder's reads fast, not every device has it
+// coherent though
+Buffer readbackBuffer(Allocator &allocator, vk::DeviceSize size) {
+  using enum vk::MemoryPropertyFlagBits;
+  auto usage = vk::BufferUsageFlagBits::eTransferDst;
+  try {
+    return Buffer(allocator, size, usage,
+                  eHostVisible | eHostCoherent | eHostCached);
+  } catch (const std::runtime_error &) {
+    return Buffer(allocator, size, usage, eHostVisible | eHostCoherent);
+  }
+}
+} // namespace
+
+Recorder::Recorder(Context &context, Renderer &vk,
+                   const std::filesystem::path &path, uint32_t every,
+                   float quantum, float timestep, uint32_t slot_count)
+    : device(vk.device), timeline(vk.sim_timeline),
+      header{.count = world::constants.obj_count,
+             .max_x = world::constants.max_x,
+             .max_y = world::constants.max_y,
+             .every = every,
+             .pos_quantum = quantum,
+             .vel_quantum = quantum,
+             .timestep = timestep} {
+  // positions and velocities, then the ids of a reordered world
+  auto bytes = (2 * sizeof(glm::vec2) + sizeof(uint32_t)) * header.count;
+  for (uint32_t i = 0; i < slot_count; i++) {
+    slots.push_back({.buffer = readbackBuffer(*context.allocator, bytes)});
+    spare.push_back(i);
+  }
+  file = std::fopen(path.c_str(), "wb");
+  if (!file)
+    throw std::runtime_error(fmt::format("can't create trajectory {}: {}",
+                                         path.string(), std::strerror(errno)));
+  if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+    std::fclose(file);
+    throw std::runtime_error(
+        fmt::format("can't write trajectory {}", path.string()));
+  }
+  writer = std::thread([this]() { run(); });
+}
+
+Recorder::~Recorder() {
+  {
+    auto lock = std::lock_guard(mutex);
+    stopping = true;
+  }
+  ready.notify_one();
+  writer.join();
+  std::fclose(file);
+}
+
+bool Recorder::capture(vk::CommandBuffer buffer, Simulation &sim) {
+  using enum vk::PipelineStageFlagBits;
+  if (sim.step == last)
+    return false;
+  uint32_t slot;
+  {
+    auto lock = std::lock_guard(mutex);
+    if (spare.empty()) {
+      dropped++;
+      return false;
+    }
+    slot = spare.back();
+    spare.pop_back();
+  }
+  last = sim.step;
+  slots[slot].step = sim.step;
+  slots[slot].permuted = sim.reorder.has_value();
+  slots[slot].half_velocity = sim.layout.half_velocity;
+  pending.push_back(slot);
+
+  auto plane = header.count * sizeof(glm::vec2);
+  computeBarrier(buffer, eTransfer);
+  buffer.copyBuffer(sim.world[sim.parity].buffer, slots[slot].buffer.buffer,
+                    {vk::BufferCopy{sim.layout.pos, 0, plane},
+                     vk::BufferCopy{sim.layout.vel, plane,
+                                    header.count * sim.layout.velSize()}});
+  if (sim.reorder)
+    buffer.copyBuffer(
+        sim.reorder->ids.buffer, slots[slot].buffer.buffer,
+        vk::BufferCopy{0, 2 * plane, header.count * sizeof(uint32_t)});
+  // the steps after it write the world the copy is still reading
+  computeBarrier(buffer, eComputeShader, eComputeShader | eTransfer);
+  buffer.pipelineBarrier(
+      eTransfer, eHost, {},
+      vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                        .dstAccessMask = vk::AccessFlagBits::eHostRead},
+      {}, {});
+  return true;
+}
+
+void Recorder::submitted(uint64_t value) {
+  if (pending.empty())
+    return;
+  {
+    auto lock = std::lock_guard(mutex);
+    for (auto slot : pending) {
+      slots[slot].value = value;
+      queue.push_back(slot);
+    }
+  }
+  pending.clear();
+  ready.notify_one();
+}
+
+void Recorder::drain() {
+  auto lock = std::unique_lock(mutex);
+  idle.wait(lock,
+            [&]() { return spare.size() + pending.size() == slots.size(); });
+}
+
+void Recorder::run() {
+  auto encoder = FrameEncoder(header);
+  std::vector<uint8_t> payload;
+  auto count = header.count;
+  // a reordered capture is put back in particle order first, the encoder
+  // deltas against the same particle's last frame
+  std::vector<glm::vec2> pos, vel, unpacked;
+  while (true) {
+    uint32_t slot;
+    {
+      auto lock = std::unique_lock(mutex);
+      ready.wait(lock, [&]() { return stopping || !queue.empty(); });
+      if (queue.empty())
+        return;
+      slot = queue.front();
+      queue.pop_front();
+    }
+    auto &captured = slots[slot];
+    vkassert(device.waitSemaphores({.semaphoreCount = 1,
+                                    .pSemaphores = &timeline,
+                                    .pValues = &captured.value},
+                                   UINT64_MAX));
+
+    bool failed;
+    {
+      auto lock = std::lock_guard(mutex);
+      failed = !error.empty();
+    }
+    if (!failed) {
+      auto planes =
+          static_cast<const glm::vec2 *>(captured.buffer.mem.mapped);
+      auto captured_pos = std::span(planes, count);
+      auto captured_vel = std::span(planes + count, count);
+      if (captured.half_velocity) {
+        unpacked.resize(count);
+        unpackVelocities(
+            {reinterpret_cast<const uint32_t *>(planes + count), count},
+            unpacked);
+        captured_vel = unpacked;
+      }
+      if (captured.permuted) {
+        auto ids = reinterpret_cast<const uint32_t *>(planes + 2 * count);
+        pos.resize(count);
+        vel.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+          pos[ids[i]] = captured_pos[i];
+          vel[ids[i]] = captured_vel[i];
+        }
+        captured_pos = pos;
+        captured_vel = vel;
+      }
+      auto frame = encoder.encode(captured.step, captured_pos, captured_vel,
+                                  payload);
+      if (std::fwrite(&frame, sizeof(frame), 1, file) == 1 &&
+          std::fwrite(payload.data(), 1, payload.size(), file) ==
+              payload.size()) {
+        frames++;
+        raw += 2 * sizeof(glm::vec2) * count;
+        written += sizeof(frame) + payload.size();
+      } else {
+        auto lock = std::lock_guard(mutex);
+        error = std::strerror(errno);
+      }
+    }
+
+    {
+      auto lock = std::lock_guard(mutex);
+      spare.push_back(slot);
+    }
+    idle.notify_all();
+  }
+}
+
+Recorder::Stats Recorder::stats() const noexcept {
+  return {.frames = frames, .dropped = dropped, .raw = raw,
+          .written = written};
+}
+
+void Recorder::show() {
+  if (!ImGui::CollapsingHeader("recording"))
+    return;
+  auto s = stats();
+  ImGui::Text("every %u steps: %llu frames, %llu dropped", header.every,
+              static_cast<unsigned long long>(s.frames),
+              static_cast<unsigned long long>(s.dropped));
+  ImGui::Text("%.1f MiB written, %.2fx smaller than raw",
+              s.written / 1048576.0,
+              s.written ? double(s.raw) / s.written : 0.0);
+  auto lock = std::lock_guard(mutex);
+  if (!error.empty())
+    ImGui::Text("stopped writing: %s", error.c_str());
+}
+
+void recordSteps(Renderer &c, vk::CommandBuffer buffer, Simulation &sim,
+                 unsigned steps, float dt, Recorder &recorder) {
+  auto every = recorder.every();
+  // a capture leaves its own barrier behind for the steps after it
+  bool fenced = true;
+  while (true) {
+    if (sim.step % every == 0)
+      fenced = recorder.capture(buffer, sim) || fenced;
+    if (steps == 0)
+      return;
+    if (!fenced)
+      computeBarrier(buffer, vk::PipelineStageFlagBits::eComputeShader);
+    auto run = static_cast<unsigned>(
+        std::min<uint64_t>(steps, every - sim.step % every));
+    recordSteps(c, buffer, sim, run, dt);
+    steps -= run;
+    fenced = false;
+  }
+}
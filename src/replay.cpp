@@ -0,0 +1,244 @@
+#include "replay.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.hpp"
+#include "imgui.h"
+#include "util/scope_guard.hpp"
+
+namespace {
+std::runtime_error systemError(std::string_view what,
+                               const std::filesystem::path &path) {
+  return std::runtime_error(
+      fmt::format("{} {}: {}", what, path.string(), std::strerror(errno)));
+}
+} // namespace
+
+Replay::Replay(const std::filesystem::path &path) {
+  auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    throw systemError("can't open trajectory", path);
+  auto close_fd = ScopeGuard([&]() { ::close(fd); });
+  struct stat info;
+  if (::fstat(fd, &info) != 0)
+    throw systemError("can't stat trajectory", path);
+  size = static_cast<size_t>(info.st_size);
+  if (size < sizeof(TrajectoryHeader))
+    throw std::runtime_error(
+        fmt::format("{} is too short to be a trajectory", path.string()));
+
+  auto mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED)
+    throw systemError("can't map trajectory", path);
+  // the kernel can drop pages behind the playhead whenever it likes, which
+  // is what lets the file outgrow memory
+  ::madvise(mapping, size, MADV_SEQUENTIAL);
+  data = static_cast<const std::byte *>(mapping);
+  head = reinterpret_cast<const TrajectoryHeader *>(data);
+
+  // frames are packed, so their headers aren't aligned
+  uint64_t at = sizeof(TrajectoryHeader);
+  bool ordered = true;
+  while (size - at >= sizeof(FrameHeader)) {
+    FrameHeader frame;
+    std::memcpy(&frame, data + at, sizeof(frame));
+    at += sizeof(frame);
+    if (frame.bytes > size - at)
+      break;
+    ordered = ordered && (index.empty() || index.back().step < frame.step);
+    index.push_back({.step = frame.step,
+                     .offset = at,
+                     .bytes = frame.bytes,
+                     .keyframe = frame.keyframe != 0});
+    at += frame.bytes;
+  }
+
+  auto &h = *head;
+  const char *problem = nullptr;
+  if (h.magic != TrajectoryHeader::file_magic)
+    problem = "isn't a trajectory";
+  else if (h.version != TrajectoryHeader::current_version)
+    problem = "was written by another version";
+  else if (h.count < 2 || !(h.max_x > 0) || !(h.max_y > 0) ||
+           !(h.pos_quantum > 0) || !(h.vel_quantum > 0) ||
+           !(h.timestep > 0) || h.every == 0 || h.keyframe_interval == 0)
+    problem = "holds no usable world";
+  else if (index.empty() || !index.front().keyframe || !ordered)
+    problem = "holds no frames or is corrupt";
+  if (problem) {
+    ::munmap(mapping, size);
+    throw std::runtime_error(fmt::format("{} {}", path.string(), problem));
+  }
+  playhead = static_cast<double>(index.front().step);
+  worker = std::thread([this]() { run(); });
+}
+
+Replay::~Replay() {
+  {
+    auto lock = std::lock_guard(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  worker.join();
+  ::munmap(const_cast<std::byte *>(data), size);
+}
+
+void Replay::advance(double seconds) {
+  if (paused)
+    return;
+  playhead += seconds * speed / head->timestep;
+  auto last = static_cast<double>(index.back().step);
+  if (playhead >= last) {
+    playhead = last;
+    paused = true;
+  }
+}
+
+bool Replay::upload(StagingRing &staging, Simulation &sim) {
+  auto frame = frameAt(playhead);
+  if (frame == shown)
+    return false;
+  const Decoded *found = nullptr;
+  {
+    auto lock = std::lock_guard(mutex);
+    want = frame;
+    while (!ready.empty() && ready.front().frame < want) {
+      spare.push_back(std::move(ready.front()));
+      ready.pop_front();
+    }
+    if (!ready.empty() && ready.front().frame == want)
+      found = &ready.front();
+  }
+  wake.notify_one();
+  if (!found)
+    return false;
+
+  // the ring copies the frame right away, the worker can have it back after
+  auto target = 1 - sim.parity;
+  staging.upload(sim.world[target].buffer, bin(found->pos), sim.layout.pos);
+  uploadVelocities(staging, sim.world[target].buffer, sim.layout, found->vel);
+  sim.parity = target;
+  sim.step = index[frame].step;
+  shown = frame;
+  return true;
+}
+
+void Replay::show() {
+  if (!ImGui::CollapsingHeader("replay", ImGuiTreeNodeFlags_DefaultOpen))
+    return;
+  uint64_t frame = shown == SIZE_MAX ? 0 : shown;
+  uint64_t first = 0, last = index.size() - 1;
+  ImGui::Text("step %llu, every %u steps",
+              static_cast<unsigned long long>(index[frame].step),
+              head->every);
+  ImGui::Checkbox("paused", &paused);
+  ImGui::SliderFloat("speed", &speed, 0, 64, "%.2fx",
+                     ImGuiSliderFlags_Logarithmic);
+  if (ImGui::SliderScalar("frame", ImGuiDataType_U64, &frame, &first, &last))
+    playhead = static_cast<double>(index[frame].step);
+  auto lock = std::lock_guard(mutex);
+  if (!error.empty())
+    ImGui::Text("stopped decoding: %s", error.c_str());
+}
+
+size_t Replay::frameAt(double step) const {
+  auto after = std::ranges::upper_bound(index, step, {}, [](auto &entry) {
+    return static_cast<double>(entry.step);
+  });
+  return after == index.begin() ? 0 : after - index.begin() - 1;
+}
+
+size_t Replay::keyframeBefore(size_t frame) const {
+  while (frame != 0 && !index[frame].keyframe)
+    frame--;
+  return frame;
+}
+
+bool Replay::busy() const {
+  auto first = ready.empty() ? next : ready.front().frame;
+  if (first > want || keyframeBefore(want) > next)
+    return true;
+  auto ahead = next > want ? next - std::max(first, want) : 0;
+  return next < index.size() && ahead < prefetch;
+}
+
+void Replay::run() {
+  auto decoder = FrameDecoder(*head);
+  auto frameOf = [&]() {
+    return Decoded{.pos = std::vector<glm::vec2>(head->count),
+                   .vel = std::vector<glm::vec2>(head->count)};
+  };
+  // frames between a keyframe and the playhead are only decoded to get there
+  auto scratch = frameOf();
+  auto lock = std::unique_lock(mutex);
+  while (true) {
+    wake.wait(lock, [&]() { return stopping || busy(); });
+    if (stopping)
+      return;
+    while (!ready.empty() && ready.front().frame < want) {
+      spare.push_back(std::move(ready.front()));
+      ready.pop_front();
+    }
+    auto first = ready.empty() ? next : ready.front().frame;
+    auto key = keyframeBefore(want);
+    if (first > want || key > next) {
+      // behind what's decoded, or far enough ahead that starting over from
+      // a keyframe is quicker
+      for (auto &frame : ready)
+        spare.push_back(std::move(frame));
+      ready.clear();
+      next = key;
+      decoder.reset();
+    }
+
+    auto frame = next++;
+    auto keep = frame >= want;
+    auto decoded = Decoded{};
+    if (keep && spare.empty()) {
+      decoded = frameOf();
+    } else if (keep) {
+      decoded = std::move(spare.back());
+      spare.pop_back();
+    }
+    lock.unlock();
+
+    // have the kernel read the frames after this one while it's decoded
+    auto ahead = std::min(frame + prefetch, index.size() - 1);
+    auto page = static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+    auto begin = index[frame].offset / page * page;
+    auto end = index[ahead].offset + index[ahead].bytes;
+    ::madvise(const_cast<std::byte *>(data) + begin, end - begin,
+              MADV_WILLNEED);
+
+    auto &target = keep ? decoded : scratch;
+    target.frame = frame;
+    auto &entry = index[frame];
+    auto header = FrameHeader{.step = entry.step,
+                              .bytes = entry.bytes,
+                              .keyframe = entry.keyframe};
+    try {
+      decoder.decode(header,
+                     {reinterpret_cast<const uint8_t *>(data + entry.offset),
+                      entry.bytes},
+                     target.pos, target.vel);
+    } catch (const std::exception &e) {
+      lock.lock();
+      error = e.what();
+      return;
+    }
+
+    lock.lock();
+    if (keep && frame >= want)
+      ready.push_back(std::move(decoded));
+    else if (keep)
+      spare.push_back(std::move(decoded));
+  }
+}
@@ -0,0 +1,114 @@
+#include "pipeline_cache.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "util/replace_file.hpp"
+
+namespace {
+namespace fs = std::filesystem;
+
+// prepended to the driver's data. the driver checks its own header too, this
+// one is there so a driver update or a different gpu never even sees a stale
+// blob
+struct Header {
+  std::array<char, 4> magic = {'p', 's', 'p', 'c'};
+  uint32_t version = 1;
+  std::array<uint8_t, VK_UUID_SIZE> device_uuid{};
+  std::array<uint8_t, VK_UUID_SIZE> cache_uuid{};
+  uint32_t driver_version = 0;
+  uint32_t vendor = 0, device = 0;
+  uint32_t reserved = 0;
+  uint64_t size = 0;
+
+  bool operator==(const Header &) const = default;
+};
+
+Header describe(vk::PhysicalDevice phys) {
+  auto chain = phys.getProperties2<vk::PhysicalDeviceProperties2,
+                                   vk::PhysicalDeviceIDProperties>();
+  auto &props = chain.get<vk::PhysicalDeviceProperties2>().properties;
+  auto &ids = chain.get<vk::PhysicalDeviceIDProperties>();
+  Header header{.driver_version = props.driverVersion,
+                .vendor = props.vendorID,
+                .device = props.deviceID};
+  std::memcpy(header.device_uuid.data(), ids.deviceUUID.data(), VK_UUID_SIZE);
+  std::memcpy(header.cache_uuid.data(), props.pipelineCacheUUID.data(),
+              VK_UUID_SIZE);
+  return header;
+}
+
+std::string hex(std::span<const uint8_t> bytes) {
+  std::string result;
+  for (auto b : bytes)
+    result += fmt::format("{:02x}", b);
+  return result;
+}
+} // namespace
+
+fs::path deviceCachePath(vk::PhysicalDevice phys, std::string_view stem,
+                         std::string_view extension) {
+  fs::path root;
+  if (auto xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg)
+    root = xdg;
+  else if (auto home = std::getenv("HOME"); home && *home)
+    root = fs::path(home) / ".cache";
+  else
+    return {};
+  auto header = describe(phys);
+  return root / "partsim" / fmt::format("{}-{}.{}", stem,
+                                        hex(header.device_uuid), extension);
+}
+
+fs::path pipelineCachePath(vk::PhysicalDevice phys) {
+  return deviceCachePath(phys, "pipelines", "bin");
+}
+
+vk::PipelineCache loadPipelineCache(vk::Device device,
+                                    vk::PhysicalDevice phys) {
+  auto path = pipelineCachePath(phys);
+  std::vector<char> data;
+  if (auto file = std::ifstream(path, std::ios::binary)) {
+    Header header;
+    auto expected = describe(phys);
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    expected.size = header.size;
+    if (file && header == expected) {
+      data.resize(header.size);
+      file.read(data.data(), data.size());
+      if (!file)
+        data.clear();
+    }
+    if (data.empty())
+      fmt::print(stderr, "ignoring stale pipeline cache {}\n", path.string());
+  }
+  return device.createPipelineCache(
+      {.initialDataSize = data.size(), .pInitialData = data.data()});
+}
+
+void savePipelineCache(vk::Device device, vk::PhysicalDevice phys,
+                       vk::PipelineCache cache) {
+  auto path = pipelineCachePath(phys);
+  if (path.empty())
+    return;
+  auto data = device.getPipelineCacheData(cache);
+  auto header = describe(phys);
+  header.size = data.size();
+
+  // renamed over the old one, so two instances exiting at once can't leave
+  // half a file behind
+  replaceFile(path, "pipeline cache", [&](std::ofstream &file) {
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(data.data()), data.size());
+  });
+}
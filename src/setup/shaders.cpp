@@ -4,13 +4,57 @@
 #include "context.hpp"
 
 namespace {
-#include "build/comp.hpp"
-#include "build/frag.hpp"
-#include "build/vert.hpp"
+#include "build/shaders/circle.frag.hpp"
+#include "build/shaders/circle.vert.hpp"
+#include "build/shaders/compute.comp.hpp"
+#include "build/shaders/fullscreen.vert.hpp"
+#include "build/shaders/cull.comp.hpp"
+#include "build/shaders/grid_collide.comp.hpp"
+#include "build/shaders/grid_count.comp.hpp"
+#include "build/shaders/grid_scatter.comp.hpp"
+#include "build/shaders/morton.comp.hpp"
+#include "build/shaders/radix_count.comp.hpp"
+#include "build/shaders/radix_scatter.comp.hpp"
+#include "build/shaders/reduce.comp.hpp"
+#include "build/shaders/reduce_final.comp.hpp"
+#include "build/shaders/reorder_gather.comp.hpp"
+#include "build/shaders/scan_add.comp.hpp"
+#include "build/shaders/scan_blocks.comp.hpp"
+#include "build/shaders/scan_reduce.comp.hpp"
+#include "build/shaders/shader.frag.hpp"
+#include "build/shaders/shader.vert.hpp"
+#include "build/shaders/splat.comp.hpp"
+#include "build/shaders/splat.frag.hpp"
+#include "build/shaders/tiled.comp.hpp"
+#include "build/shaders/verlet_build.comp.hpp"
+#include "build/shaders/verlet_check.comp.hpp"
+#include "build/shaders/verlet_collide.comp.hpp"
 } // namespace
 
 namespace shaders {
-std::span<const uint32_t> vertex() { return vert; }
-std::span<const uint32_t> fragment() { return frag; }
-std::span<const uint32_t> compute() { return comp; }
-} // namespace shaders
\ No newline at end of file
+std::span<const uint32_t> vertex() { return shader_vert; }
+std::span<const uint32_t> fragment() { return shader_frag; }
+std::span<const uint32_t> circleVertex() { return circle_vert; }
+std::span<const uint32_t> circleFragment() { return circle_frag; }
+std::span<const uint32_t> compute() { return compute_comp; }
+std::span<const uint32_t> cull() { return cull_comp; }
+std::span<const uint32_t> splat() { return splat_comp; }
+std::span<const uint32_t> fullscreen() { return fullscreen_vert; }
+std::span<const uint32_t> splatFragment() { return splat_frag; }
+std::span<const uint32_t> tiled() { return tiled_comp; }
+std::span<const uint32_t> reduce() { return reduce_comp; }
+std::span<const uint32_t> reduceFinal() { return reduce_final_comp; }
+std::span<const uint32_t> scanReduce() { return scan_reduce_comp; }
+std::span<const uint32_t> scanBlocks() { return scan_blocks_comp; }
+std::span<const uint32_t> scanAdd() { return scan_add_comp; }
+std::span<const uint32_t> gridCount() { return grid_count_comp; }
+std::span<const uint32_t> gridScatter() { return grid_scatter_comp; }
+std::span<const uint32_t> gridCollide() { return grid_collide_comp; }
+std::span<const uint32_t> morton() { return morton_comp; }
+std::span<const uint32_t> radixCount() { return radix_count_comp; }
+std::span<const uint32_t> radixScatter() { return radix_scatter_comp; }
+std::span<const uint32_t> reorderGather() { return reorder_gather_comp; }
+std::span<const uint32_t> verletCheck() { return verlet_check_comp; }
+std::span<const uint32_t> verletBuild() { return verlet_build_comp; }
+std::span<const uint32_t> verletCollide() { return verlet_collide_comp; }
+} // namespace shaders
@@ -1,4 +1,5 @@
 #include <SDL2/SDL_vulkan.h>
+#include <chrono>
 #include <cstddef>
 #include <cstdio>
 #include <fmt/core.h>
@@ -11,6 +12,7 @@
 
 #include "constants.hpp"
 #include "context.hpp"
+#include "pipeline_cache.hpp"
 #include "queues.hpp"
 #include "ubo.hpp"
 #include "util/scope_guard.hpp"
@@ -29,8 +31,67 @@ struct SwapChainSupportDetails {
 };
 
 constexpr std::array deviceExtensions = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
     VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME};
+// only needed when there is a surface to present to
+constexpr std::array presentExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+
+std::vector<const char *> requiredExtensions(bool headless) {
+  std::vector<const char *> extensions(deviceExtensions.begin(),
+                                       deviceExtensions.end());
+  if (!headless)
+    extensions.insert(extensions.end(), presentExtensions.begin(),
+                      presentExtensions.end());
+  return extensions;
+}
+
+// every compute kernel and the vertex shader share one descriptor set layout
+// so the same set can be bound to both pipelines. the last three are the
+// culling pass's visible list and draw command and the splatting pass's
+// density grid, only display sets fill them
+constexpr auto world_bindings = [] {
+  std::array<vk::DescriptorSetLayoutBinding, 14> bindings;
+  for (uint32_t i = 0; i < bindings.size(); i++) {
+    bindings[i] = {.binding = i,
+                   .descriptorType = vk::DescriptorType::eStorageBuffer,
+                   .descriptorCount = 1,
+                   .stageFlags = vk::ShaderStageFlagBits::eVertex |
+                                 vk::ShaderStageFlagBits::eFragment |
+                                 vk::ShaderStageFlagBits::eCompute};
+  }
+  return bindings;
+}();
+
+constexpr auto compute_spec_map = std::to_array<vk::SpecializationMapEntry>(
+    {{.constantID = 0,
+      .offset = offsetof(world::constants_t, obj_count),
+      .size = sizeof(world::constants.obj_count)},
+     {.constantID = 1,
+      .offset = offsetof(world::constants_t, max_x),
+      .size = sizeof(world::constants.max_x)},
+     {.constantID = 2,
+      .offset = offsetof(world::constants_t, max_y),
+      .size = sizeof(world::constants.max_y)},
+     {.constantID = 3,
+      .offset = offsetof(world::constants_t, grid_w),
+      .size = sizeof(world::constants.grid_w)},
+     {.constantID = 4,
+      .offset = offsetof(world::constants_t, grid_h),
+      .size = sizeof(world::constants.grid_h)},
+     {.constantID = 5,
+      .offset = offsetof(world::constants_t, work_size),
+      .size = sizeof(world::constants.work_size)},
+     {.constantID = 6,
+      .offset = offsetof(world::constants_t, half_velocity),
+      .size = sizeof(world::constants.half_velocity)},
+     {.constantID = 7,
+      .offset = offsetof(world::constants_t, skin),
+      .size = sizeof(world::constants.skin)}});
+
+const vk::SpecializationInfo compute_specialization{
+    .mapEntryCount = compute_spec_map.size(),
+    .pMapEntries = compute_spec_map.data(),
+    .dataSize = sizeof(world::constants),
+    .pData = &world::constants};
 
 inline VKAPI_ATTR VkBool32 VKAPI_CALL
 debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT sev,
@@ -45,9 +106,10 @@ debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT sev,
   return VK_FALSE;
 }
 
-vk::Instance setupInstance(Window &win) {
+vk::Instance setupInstance(std::vector<const char *> extensions,
+                           bool validation) {
 
-  if (enableValidation && !check_validation_support()) {
+  if (validation && !check_validation_support()) {
     throw std::runtime_error("validation layers requested, but not available!");
   }
 
@@ -55,15 +117,16 @@ vk::Instance setupInstance(Window &win) {
                               .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
                               .pEngineName = "None",
                               .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-                              .apiVersion = VK_API_VERSION_1_0};
+                              .apiVersion = VK_API_VERSION_1_2};
 
-  auto extensions = win.getVkExtentions();
-  extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  if (validation)
+    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
   vk::InstanceCreateInfo createInfo{
       .flags = {},
       .pApplicationInfo = &appInfo,
-      .enabledLayerCount = validationLayers.size(),
+      .enabledLayerCount =
+          validation ? static_cast<uint32_t>(validationLayers.size()) : 0,
       .ppEnabledLayerNames = validationLayers.data(),
       .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
       .ppEnabledExtensionNames = extensions.data()};
@@ -71,8 +134,8 @@ vk::Instance setupInstance(Window &win) {
   return vk::createInstance(createInfo);
 }
 
-vk::DebugUtilsMessengerEXT setupDebug(vk::Instance instance) {
-  if (!enableValidation)
+vk::DebugUtilsMessengerEXT setupDebug(vk::Instance instance, bool validation) {
+  if (!validation)
     return nullptr;
   using enum vk::DebugUtilsMessageSeverityFlagBitsEXT;
   using enum vk::DebugUtilsMessageTypeFlagBitsEXT;
@@ -101,26 +164,42 @@ vk::DebugUtilsMessengerEXT setupDebug(vk::Instance instance) {
 Indicies findQueueFamilies(vk::SurfaceKHR surface, vk::PhysicalDevice phys) {
   Indicies i;
   int index = 0;
-  for (auto &property : phys.getQueueFamilyProperties()) {
+  auto families = phys.getQueueFamilyProperties();
+  for (auto &property : families) {
+    // the culling pass dispatches on the graphics queue right before the
+    // render pass
     if (property.queueFlags & vk::QueueFlagBits::eGraphics &&
+        property.queueFlags & vk::QueueFlagBits::eCompute &&
         i.graphics == -1) {
       i.graphics = index;
     }
+    // a transfer only family is the copy engine, uploads on it don't take
+    // time from the rendering or the simulation
+    auto only_transfer =
+        !(property.queueFlags &
+          (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute));
     if (property.queueFlags & vk::QueueFlagBits::eTransfer &&
-        i.transfer == -1) {
+        (i.transfer == -1 || only_transfer)) {
       i.transfer = index;
     }
-    if (property.queueFlags & vk::QueueFlagBits::eCompute && i.compute == -1) {
+    // a compute family without graphics is usually a separate hardware
+    // queue, so the simulation can run next to the rendering
+    if (property.queueFlags & vk::QueueFlagBits::eCompute &&
+        (i.compute == -1 ||
+         (families[i.compute].queueFlags & vk::QueueFlagBits::eGraphics &&
+          !(property.queueFlags & vk::QueueFlagBits::eGraphics)))) {
       i.compute = index;
     }
-    if (phys.getSurfaceSupportKHR(index, surface) && i.present == -1) {
+    if (surface && phys.getSurfaceSupportKHR(index, surface) &&
+        i.present == -1) {
       i.present = index;
     }
-
-    if (i.graphics != -1 && i.transfer != -1 && i.present != -1)
-      break;
     index++;
   }
+  // headless the graphics queue only runs setup commands, which any compute
+  // family can, so compute only devices work too
+  if (!surface && i.graphics == -1)
+    i.graphics = i.compute;
   return i;
 }
 
@@ -133,17 +212,38 @@ SwapChainSupportDetails querySwapchainSupport(vk::SurfaceKHR surface,
   return details;
 }
 
-bool checkExtensionSupport(vk::PhysicalDevice device) {
+// the kernels count collisions and reduce observables with subgroup
+// arithmetic, which vulkan 1.1 makes queryable but not mandatory. the
+// simulation queue is synchronized with timeline semaphores from 1.2
+bool checkFeatureSupport(vk::PhysicalDevice device) {
+  if (device.getProperties().apiVersion < VK_API_VERSION_1_2)
+    return false;
+  auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                      vk::PhysicalDeviceVulkan12Features>();
+  if (!features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore)
+    return false;
+  auto props = device.getProperties2<vk::PhysicalDeviceProperties2,
+                                     vk::PhysicalDeviceSubgroupProperties>();
+  auto &subgroup = props.get<vk::PhysicalDeviceSubgroupProperties>();
+  using enum vk::SubgroupFeatureFlagBits;
+  return (subgroup.supportedStages & vk::ShaderStageFlagBits::eCompute) &&
+         (subgroup.supportedOperations & eBasic) &&
+         (subgroup.supportedOperations & eBallot) &&
+         (subgroup.supportedOperations & eArithmetic);
+}
+
+bool checkExtensionSupport(vk::PhysicalDevice device, bool headless) {
   auto availableExtensions = device.enumerateDeviceExtensionProperties();
 
-  auto requiredExtensions = std::unordered_set<std::string>(
-      deviceExtensions.begin(), deviceExtensions.end());
+  auto required = requiredExtensions(headless);
+  auto missing = std::unordered_set<std::string>(required.begin(),
+                                                 required.end());
 
   for (const auto &extension : availableExtensions) {
-    requiredExtensions.erase(extension.extensionName);
+    missing.erase(extension.extensionName);
   }
 
-  return requiredExtensions.empty();
+  return missing.empty();
 }
 
 vk::PresentModeKHR chooseSwapPresentMode(
@@ -175,7 +275,7 @@ vk::Extent2D chooseSwapExtent(Context &c,
       std::numeric_limits<uint32_t>::max()) {
     return capabilities.currentExtent;
   } else {
-    auto [width, height] = c.window.getBufferSize();
+    auto [width, height] = c.window->getBufferSize();
 
     vk::Extent2D extent = {static_cast<uint32_t>(width),
                            static_cast<uint32_t>(height)};
@@ -192,11 +292,13 @@ vk::Extent2D chooseSwapExtent(Context &c,
 
 std::pair<int, Indicies> isDeviceSuitable(vk::SurfaceKHR surface,
                                           vk::PhysicalDevice device) {
+  bool headless = !surface;
   Indicies indices = findQueueFamilies(surface, device);
-  bool extensions_supported = checkExtensionSupport(device);
-  auto swapchain_details = querySwapchainSupport(surface, device);
+  bool extensions_supported = checkExtensionSupport(device, headless);
+  bool swapchain_ok = headless || querySwapchainSupport(surface, device).ok();
   int score = 1;
-  if (!(indices.isComplete() && extensions_supported && swapchain_details.ok()))
+  if (!(indices.isComplete(headless) && extensions_supported && swapchain_ok &&
+        checkFeatureSupport(device)))
     return {-1, indices};
   auto props = device.getProperties();
   if (props.deviceType == vk::PhysicalDeviceType::eDiscreteGpu) {
@@ -222,31 +324,48 @@ void setupDevice(Context &c) {
     }
   }
   c.indicies = indicies;
-  auto &[graphics, present, transfer, comp] = indicies;
+  auto &[graphics, transfer, present, comp] = indicies;
 
   if (!chosen)
     throw std::runtime_error("Could not find a vulkan-compatable device!");
 
-  if (present != graphics)
+  if (c.surface && present != graphics)
     throw std::runtime_error(
         "Seperate graphics and present queue not supported");
   c.phys = chosen;
 
-  float queuePriority = 1.0f;
-  vk::DeviceQueueCreateInfo queueCreateInfo{.queueFamilyIndex =
-                                                static_cast<uint32_t>(graphics),
-                                            .queueCount = 1,
-                                            .pQueuePriorities = &queuePriority};
-  vk::PhysicalDeviceFeatures deviceFeatures{};
+  // the simulation gets its own queue, from a second slot of the graphics
+  // family if there is no separate compute family
+  auto families = chosen.getQueueFamilyProperties();
+  uint32_t compute_slot = 0;
+  if (comp == graphics && families[graphics].queueCount > 1)
+    compute_slot = 1;
+
+  std::array queuePriorities = {1.0f, 1.0f};
+  std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
+  for (int family : std::unordered_set<int>{graphics, transfer, comp}) {
+    queueCreateInfos.push_back(
+        {.queueFamilyIndex = static_cast<uint32_t>(family),
+         .queueCount = family == comp ? compute_slot + 1 : 1,
+         .pQueuePriorities = queuePriorities.data()});
+  }
+  vk::PhysicalDeviceVulkan12Features features12{.timelineSemaphore = true};
+  // the profiler's pipeline statistics are optional
+  vk::PhysicalDeviceFeatures deviceFeatures{
+      .pipelineStatisticsQuery =
+          chosen.getFeatures().pipelineStatisticsQuery};
+  c.features = deviceFeatures;
+  auto extensions = requiredExtensions(!c.surface);
   vk::DeviceCreateInfo createInfo{
-      .queueCreateInfoCount = 1,
-      .pQueueCreateInfos = &queueCreateInfo,
-      .enabledExtensionCount = deviceExtensions.size(),
-      .ppEnabledExtensionNames = deviceExtensions.data(),
+      .pNext = &features12,
+      .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size()),
+      .pQueueCreateInfos = queueCreateInfos.data(),
+      .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+      .ppEnabledExtensionNames = extensions.data(),
       .pEnabledFeatures = &deviceFeatures,
   };
 
-  if (enableValidation) {
+  if (c.validation) {
     createInfo.enabledLayerCount =
         static_cast<uint32_t>(validationLayers.size());
     createInfo.ppEnabledLayerNames = validationLayers.data();
@@ -257,6 +376,7 @@ void setupDevice(Context &c) {
   c.device = chosen.createDevice(createInfo);
   c.queues.set_graphics(c.device.getQueue(graphics, 0));
   c.queues.set_transfer(c.device.getQueue(transfer, 0));
+  c.queues.set_compute(c.device.getQueue(comp, compute_slot));
 }
 
 vk::Format setupSwapchain(Context &c) {
@@ -292,17 +412,18 @@ vk::Format setupSwapchain(Context &c) {
 }
 
 void setupShaderAndPipeline(Context &c, Renderer &r) {
-  auto f = shaders::fragment();
+  auto circle = r.sprite == Sprite::circle;
+  auto f = circle ? shaders::circleFragment() : shaders::fragment();
   auto frag = c.device.createShaderModule(vk::ShaderModuleCreateInfo{
       .codeSize = f.size_bytes(), .pCode = f.data()});
   auto frag_guard = ScopeGuard([&]() { c.device.destroyShaderModule(frag); });
-  auto v = shaders::vertex();
+  auto v = circle ? shaders::circleVertex() : shaders::vertex();
   auto vert = c.device.createShaderModule(vk::ShaderModuleCreateInfo{
       .codeSize = v.size_bytes(), .pCode = v.data()});
   auto vert_guard = ScopeGuard([&]() { c.device.destroyShaderModule(vert); });
 
-  ScreenScale scale = {1 / 50.0, 1 / 30.0};
-  unsigned count = world::object_count;
+  ScreenScale scale = screen_scale;
+  unsigned count = world::constants.obj_count;
   std::array spec_map{
       vk::SpecializationMapEntry{.constantID = 0,
                                  .offset = offsetof(ScreenScale, width),
@@ -332,11 +453,14 @@ void setupShaderAndPipeline(Context &c, Renderer &r) {
   auto bindingDescription = Vertex::getBindingDescription();
   auto attributeDescriptions = Vertex::getAttributeDescriptions();
 
-  vert_in_info.vertexBindingDescriptionCount = 1;
-  vert_in_info.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(attributeDescriptions.size());
-  vert_in_info.pVertexBindingDescriptions = &bindingDescription;
-  vert_in_info.pVertexAttributeDescriptions = attributeDescriptions.data();
+  // the circle's corners are constants in the shader
+  if (!circle) {
+    vert_in_info.vertexBindingDescriptionCount = 1;
+    vert_in_info.vertexAttributeDescriptionCount =
+        static_cast<uint32_t>(attributeDescriptions.size());
+    vert_in_info.pVertexBindingDescriptions = &bindingDescription;
+    vert_in_info.pVertexAttributeDescriptions = attributeDescriptions.data();
+  }
 
   vk::PipelineInputAssemblyStateCreateInfo in_assembly{
       .topology = vk::PrimitiveTopology::eTriangleList};
@@ -354,7 +478,15 @@ void setupShaderAndPipeline(Context &c, Renderer &r) {
       .rasterizationSamples = vk::SampleCountFlagBits::e1};
 
   using enum vk::ColorComponentFlagBits;
+  // the circle's edge is blended by its coverage
   vk::PipelineColorBlendAttachmentState colorblend_attachment{
+      .blendEnable = circle,
+      .srcColorBlendFactor = vk::BlendFactor::eSrcAlpha,
+      .dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha,
+      .colorBlendOp = vk::BlendOp::eAdd,
+      .srcAlphaBlendFactor = vk::BlendFactor::eOne,
+      .dstAlphaBlendFactor = vk::BlendFactor::eZero,
+      .alphaBlendOp = vk::BlendOp::eAdd,
       .colorWriteMask = eR | eG | eB | eA};
 
   vk::PipelineColorBlendStateCreateInfo colorblending{
@@ -368,20 +500,9 @@ void setupShaderAndPipeline(Context &c, Renderer &r) {
       .dynamicStateCount = dynamic_states.size(),
       .pDynamicStates = dynamic_states.data()};
 
-  auto bindings = std::to_array<vk::DescriptorSetLayoutBinding>(
-      {{.binding = 0,
-        .descriptorType = vk::DescriptorType::eStorageBuffer,
-        .descriptorCount = 1,
-        .stageFlags = vk::ShaderStageFlagBits::eVertex |
-                      vk::ShaderStageFlagBits::eCompute},
-       {.binding = 1,
-        .descriptorType = vk::DescriptorType::eStorageBuffer,
-        .descriptorCount = 1,
-        .stageFlags = vk::ShaderStageFlagBits::eVertex |
-                      vk::ShaderStageFlagBits::eCompute}});
-
   r.descriptor_layout = c.device.createDescriptorSetLayout(
-      {.bindingCount = bindings.size(), .pBindings = bindings.data()});
+      {.bindingCount = world_bindings.size(),
+       .pBindings = world_bindings.data()});
 
   vk::PushConstantRange push_constant;
   push_constant.offset = 0;
@@ -410,7 +531,7 @@ void setupShaderAndPipeline(Context &c, Renderer &r) {
       .renderPass = r.pass,
       .subpass = 0};
   if (auto &&[err, result] =
-          c.device.createGraphicsPipeline(nullptr, pipeline_info);
+          c.device.createGraphicsPipeline(r.pipeline_cache, pipeline_info);
       err == vk::Result::eSuccess) {
     r.graphics_pipe = result;
   } else {
@@ -418,57 +539,332 @@ void setupShaderAndPipeline(Context &c, Renderer &r) {
   }
 }
 
+vk::Pipeline createComputePipe(Renderer &r, std::span<const uint32_t> code,
+                               const vk::SpecializationInfo &spec,
+                               vk::PipelineLayout layout = nullptr) {
+  auto comp = r.device.createShaderModule(vk::ShaderModuleCreateInfo{
+      .codeSize = code.size_bytes(), .pCode = code.data()});
+  auto guard = ScopeGuard([&]() { r.device.destroyShaderModule(comp); });
+
+  auto [result, pipeline] = r.device.createComputePipeline(
+      r.pipeline_cache, {.stage = {.stage = vk::ShaderStageFlagBits::eCompute,
+                          .module = comp,
+                          .pName = "main",
+                          .pSpecializationInfo = &spec},
+                .layout = layout ? layout : r.compute_layout});
+  if (result != vk::Result::eSuccess) {
+    throw std::runtime_error(vk::to_string(result));
+  }
+  return pipeline;
+}
+
 void setupCompute(Context &c, Renderer &r) {
-  auto shader = shaders::compute();
-  auto comp = c.device.createShaderModule(vk::ShaderModuleCreateInfo{
-      .codeSize = shader.size_bytes(), .pCode = shader.data()});
-  auto guard = ScopeGuard([&]() { c.device.destroyShaderModule(comp); });
+  auto limits = c.phys.getProperties().limits;
+  auto work_size = world::constants.work_size;
+  if (work_size > limits.maxComputeWorkGroupSize[0] ||
+      work_size > limits.maxComputeWorkGroupInvocations)
+    throw std::runtime_error(
+        fmt::format("workgroup size {} is over the device's limit of {}",
+                    work_size,
+                    std::min(limits.maxComputeWorkGroupSize[0],
+                             limits.maxComputeWorkGroupInvocations)));
+
+  r.compute_desc_layout = r.device.createDescriptorSetLayout(
+      {.bindingCount = world_bindings.size(),
+       .pBindings = world_bindings.data()});
+
+  vk::PushConstantRange push_constant{
+      .stageFlags = vk::ShaderStageFlagBits::eCompute,
+      .offset = 0,
+      .size = sizeof(StepConstants)};
+
+  r.compute_layout = r.device.createPipelineLayout(
+      {.setLayoutCount = 1,
+       .pSetLayouts = &r.compute_desc_layout,
+       .pushConstantRangeCount = 1,
+       .pPushConstantRanges = &push_constant});
+
+  // the grid kernel only needs this pipeline when comparing against it
+  auto code =
+      r.kernel == Kernel::tiled ? shaders::tiled() : shaders::compute();
+  r.compute_pipe = createComputePipe(r, code, compute_specialization);
+
+  r.reduce_pipe =
+      createComputePipe(r, shaders::reduce(), compute_specialization);
+  r.reduce_final_pipe =
+      createComputePipe(r, shaders::reduceFinal(), compute_specialization);
+}
 
+// the scans bind their input, output and block sums as a second set next to
+// the world, with the kernels' push constants so neither has to be redone
+// around them
+void setupScan(Context &c, Renderer &r) {
+  std::array<vk::DescriptorSetLayoutBinding, 3> bindings;
+  for (uint32_t i = 0; i < bindings.size(); i++) {
+    bindings[i] = {.binding = i,
+                   .descriptorType = vk::DescriptorType::eStorageBuffer,
+                   .descriptorCount = 1,
+                   .stageFlags = vk::ShaderStageFlagBits::eCompute};
+  }
+  r.scan_desc_layout = r.device.createDescriptorSetLayout(
+      {.bindingCount = bindings.size(), .pBindings = bindings.data()});
+  vk::PushConstantRange push_constant{
+      .stageFlags = vk::ShaderStageFlagBits::eCompute,
+      .offset = 0,
+      .size = sizeof(StepConstants)};
+  auto set_layouts = std::array{r.compute_desc_layout, r.scan_desc_layout};
+  r.scan_layout = r.device.createPipelineLayout(
+      {.setLayoutCount = set_layouts.size(),
+       .pSetLayouts = set_layouts.data(),
+       .pushConstantRangeCount = 1,
+       .pPushConstantRanges = &push_constant});
+}
+
+// the scan's length is a specialization constant like the world's sizes, so
+// every scanned buffer gets its own pipelines
+ScanPipes createScan(Renderer &r, uint32_t count) {
+  struct Specialization {
+    uint32_t work_size, count;
+  };
+  auto spec = Specialization{.work_size = world::constants.work_size,
+                             .count = count};
   auto spec_map = std::to_array<vk::SpecializationMapEntry>(
-      {{.constantID = 0,
-        .offset = offsetof(world::constants_t, obj_count),
-        .size = sizeof(world::constants.obj_count)},
-       {.constantID = 1,
-        .offset = offsetof(world::constants_t, max_x),
-        .size = sizeof(world::constants.max_x)},
-       {.constantID = 2,
-        .offset = offsetof(world::constants_t, max_y),
-        .size = sizeof(world::constants.max_y)}});
+      {{.constantID = 5,
+        .offset = offsetof(Specialization, work_size),
+        .size = sizeof(spec.work_size)},
+       {.constantID = 8,
+        .offset = offsetof(Specialization, count),
+        .size = sizeof(spec.count)}});
+  vk::SpecializationInfo info{.mapEntryCount = spec_map.size(),
+                              .pMapEntries = spec_map.data(),
+                              .dataSize = sizeof(spec),
+                              .pData = &spec};
+  return {
+      .reduce = createComputePipe(r, shaders::scanReduce(), info,
+                                  r.scan_layout),
+      .blocks = createComputePipe(r, shaders::scanBlocks(), info,
+                                  r.scan_layout),
+      .add = createComputePipe(r, shaders::scanAdd(), info, r.scan_layout),
+      .count = count};
+}
 
-  vk::SpecializationInfo specialization_info{.mapEntryCount = spec_map.size(),
-                                             .pMapEntries = spec_map.data(),
-                                             .dataSize =
-                                                 sizeof(world::constants),
-                                             .pData = &world::constants};
-
-  auto bindings = std::to_array<vk::DescriptorSetLayoutBinding>(
-      {{.binding = 0,
-        .descriptorType = vk::DescriptorType::eStorageBuffer,
-        .descriptorCount = 1,
-        .stageFlags = vk::ShaderStageFlagBits::eVertex |
-                      vk::ShaderStageFlagBits::eCompute},
-       {.binding = 1,
-        .descriptorType = vk::DescriptorType::eStorageBuffer,
-        .descriptorCount = 1,
-        .stageFlags = vk::ShaderStageFlagBits::eVertex |
-                      vk::ShaderStageFlagBits::eCompute}});
+void destroyScan(vk::Device device, ScanPipes &scan) {
+  device.destroyPipeline(scan.reduce);
+  device.destroyPipeline(scan.blocks);
+  device.destroyPipeline(scan.add);
+}
 
-  r.compute_desc_layout = r.device.createDescriptorSetLayout(
+// the cell list broadphase is four passes sharing the layout of the naive
+// kernel: count particles per cell, scan the counts into offsets, scatter
+// particle indices into their cell's range and finally test neighbour cells
+void setupGrid(Context &c, Renderer &r) {
+  r.grid_count_pipe =
+      createComputePipe(r, shaders::gridCount(), compute_specialization);
+  r.grid_scan = createScan(
+      r, static_cast<uint32_t>(world::constants.cellCount()));
+  r.grid_scatter_pipe =
+      createComputePipe(r, shaders::gridScatter(), compute_specialization);
+  r.grid_collide_pipe =
+      createComputePipe(r, shaders::gridCollide(), compute_specialization);
+}
+
+// the morton reordering binds the sort's buffers as a second set next to the
+// world: keys and slots in and out, the digit histogram and the particle ids
+// before and after
+void setupReorder(Context &c, Renderer &r) {
+  std::array<vk::DescriptorSetLayoutBinding, 7> bindings;
+  for (uint32_t i = 0; i < bindings.size(); i++) {
+    bindings[i] = {.binding = i,
+                   .descriptorType = vk::DescriptorType::eStorageBuffer,
+                   .descriptorCount = 1,
+                   .stageFlags = vk::ShaderStageFlagBits::eCompute};
+  }
+  r.reorder_desc_layout = r.device.createDescriptorSetLayout(
       {.bindingCount = bindings.size(), .pBindings = bindings.data()});
 
-  r.compute_layout = r.device.createPipelineLayout(
-      {.setLayoutCount = 1, .pSetLayouts = &r.compute_desc_layout});
+  // the passes keying and gathering the world declare the kernels' push
+  // constants without using them, the range has to cover those as well. the
+  // histogram's scan keeps the shift pushed only while the ranges match
+  static_assert(sizeof(RadixConstants) <= sizeof(StepConstants));
+  vk::PushConstantRange push_constant{
+      .stageFlags = vk::ShaderStageFlagBits::eCompute,
+      .offset = 0,
+      .size = static_cast<uint32_t>(
+          std::max(sizeof(StepConstants), sizeof(RadixConstants)))};
+  auto set_layouts = std::array{r.compute_desc_layout, r.reorder_desc_layout};
+  r.reorder_layout = r.device.createPipelineLayout(
+      {.setLayoutCount = set_layouts.size(),
+       .pSetLayouts = set_layouts.data(),
+       .pushConstantRangeCount = 1,
+       .pPushConstantRanges = &push_constant});
+
+  auto pipe = [&](std::span<const uint32_t> code) {
+    return createComputePipe(r, code, compute_specialization,
+                             r.reorder_layout);
+  };
+  r.morton_pipe = pipe(shaders::morton());
+  r.radix_count_pipe = pipe(shaders::radixCount());
+  r.radix_scan = createScan(r, world::constants.radixDigits());
+  r.radix_scatter_pipe = pipe(shaders::radixScatter());
+  r.reorder_gather_pipe = pipe(shaders::reorderGather());
+}
 
-  auto [result, pipeline] = r.device.createComputePipeline(
-      nullptr, {.stage = {.stage = vk::ShaderStageFlagBits::eCompute,
-                          .module = comp,
-                          .pName = "main",
-                          .pSpecializationInfo = &specialization_info},
-                .layout = r.compute_layout});
-  if (result != vk::Result::eSuccess) {
-    throw std::runtime_error(vk::to_string(result));
+// the verlet kernel binds the neighbour lists, their origins and its
+// bookkeeping as a second set next to the world. the push constants match
+// compute_layout's, so the world stays bound for the cell list's passes it
+// builds the lists out of
+void setupVerlet(Context &c, Renderer &r) {
+  std::array<vk::DescriptorSetLayoutBinding, 4> bindings;
+  for (uint32_t i = 0; i < bindings.size(); i++) {
+    bindings[i] = {.binding = i,
+                   .descriptorType = vk::DescriptorType::eStorageBuffer,
+                   .descriptorCount = 1,
+                   .stageFlags = vk::ShaderStageFlagBits::eCompute};
+  }
+  r.verlet_desc_layout = r.device.createDescriptorSetLayout(
+      {.bindingCount = bindings.size(), .pBindings = bindings.data()});
+  vk::PushConstantRange push_constant{
+      .stageFlags = vk::ShaderStageFlagBits::eCompute,
+      .offset = 0,
+      .size = sizeof(StepConstants)};
+  auto set_layouts = std::array{r.compute_desc_layout, r.verlet_desc_layout};
+  r.verlet_layout = r.device.createPipelineLayout(
+      {.setLayoutCount = set_layouts.size(),
+       .pSetLayouts = set_layouts.data(),
+       .pushConstantRangeCount = 1,
+       .pPushConstantRanges = &push_constant});
+  auto pipe = [&](std::span<const uint32_t> code) {
+    return createComputePipe(r, code, compute_specialization,
+                             r.verlet_layout);
+  };
+  r.verlet_check_pipe = pipe(shaders::verletCheck());
+  r.verlet_build_pipe = pipe(shaders::verletBuild());
+  r.verlet_collide_pipe = pipe(shaders::verletCollide());
+}
+
+// the culling and splatting passes run on the display sets the vertex shader
+// gets, with the particle count, workgroup size and velocity layout of the
+// kernels and the vertex shader's scale
+void setupViewPasses(Context &c, Renderer &r) {
+  struct Specialization {
+    uint32_t count, work_size, half_velocity;
+    ScreenScale scale;
+  };
+  static_assert(sizeof(ScreenScale) == 2 * sizeof(float));
+  auto spec = Specialization{.count = world::constants.obj_count,
+                             .work_size = world::constants.work_size,
+                             .half_velocity = world::constants.half_velocity,
+                             .scale = screen_scale};
+  auto spec_map = std::to_array<vk::SpecializationMapEntry>(
+      {{.constantID = 0,
+        .offset = offsetof(Specialization, count),
+        .size = sizeof(spec.count)},
+       {.constantID = 5,
+        .offset = offsetof(Specialization, work_size),
+        .size = sizeof(spec.work_size)},
+       {.constantID = 6,
+        .offset = offsetof(Specialization, half_velocity),
+        .size = sizeof(spec.half_velocity)},
+       {.constantID = 7,
+        .offset = offsetof(Specialization, scale) +
+                  offsetof(ScreenScale, width),
+        .size = sizeof(float)},
+       {.constantID = 8,
+        .offset = offsetof(Specialization, scale) +
+                  offsetof(ScreenScale, height),
+        .size = sizeof(float)}});
+  vk::SpecializationInfo info{.mapEntryCount = spec_map.size(),
+                              .pMapEntries = spec_map.data(),
+                              .dataSize = sizeof(spec),
+                              .pData = &spec};
+
+  vk::PushConstantRange push_constant{
+      .stageFlags = vk::ShaderStageFlagBits::eCompute,
+      .offset = 0,
+      .size = sizeof(CullConstants)};
+  r.cull_layout = c.device.createPipelineLayout(
+      {.setLayoutCount = 1,
+       .pSetLayouts = &r.descriptor_layout,
+       .pushConstantRangeCount = 1,
+       .pPushConstantRanges = &push_constant});
+  r.cull_pipe = createComputePipe(r, shaders::cull(), info, r.cull_layout);
+
+  vk::PushConstantRange splat_constant{
+      .stageFlags = vk::ShaderStageFlagBits::eCompute |
+                    vk::ShaderStageFlagBits::eFragment,
+      .offset = 0,
+      .size = sizeof(SplatConstants)};
+  r.splat_layout = c.device.createPipelineLayout(
+      {.setLayoutCount = 1,
+       .pSetLayouts = &r.descriptor_layout,
+       .pushConstantRangeCount = 1,
+       .pPushConstantRanges = &splat_constant});
+  r.splat_pipe = createComputePipe(r, shaders::splat(), info, r.splat_layout);
+
+  auto v = shaders::fullscreen();
+  auto vert = c.device.createShaderModule(vk::ShaderModuleCreateInfo{
+      .codeSize = v.size_bytes(), .pCode = v.data()});
+  auto vert_guard = ScopeGuard([&]() { c.device.destroyShaderModule(vert); });
+  auto f = shaders::splatFragment();
+  auto frag = c.device.createShaderModule(vk::ShaderModuleCreateInfo{
+      .codeSize = f.size_bytes(), .pCode = f.data()});
+  auto frag_guard = ScopeGuard([&]() { c.device.destroyShaderModule(frag); });
+  std::array stages = {
+      vk::PipelineShaderStageCreateInfo{.stage =
+                                            vk::ShaderStageFlagBits::eVertex,
+                                        .module = vert,
+                                        .pName = "main"},
+      vk::PipelineShaderStageCreateInfo{
+          .stage = vk::ShaderStageFlagBits::eFragment,
+          .module = frag,
+          .pName = "main"}};
+
+  // one triangle from its vertex indices, covering every pixel once
+  vk::PipelineVertexInputStateCreateInfo vert_in_info{};
+  vk::PipelineInputAssemblyStateCreateInfo in_assembly{
+      .topology = vk::PrimitiveTopology::eTriangleList};
+  vk::PipelineViewportStateCreateInfo viewport_state{.viewportCount = 1,
+                                                     .scissorCount = 1};
+  vk::PipelineRasterizationStateCreateInfo rasterizer{
+      .polygonMode = vk::PolygonMode::eFill,
+      .cullMode = vk::CullModeFlagBits::eNone,
+      .frontFace = vk::FrontFace::eClockwise,
+      .lineWidth = 1.0};
+  vk::PipelineMultisampleStateCreateInfo multisampling{
+      .rasterizationSamples = vk::SampleCountFlagBits::e1};
+  using enum vk::ColorComponentFlagBits;
+  vk::PipelineColorBlendAttachmentState colorblend_attachment{
+      .blendEnable = false, .colorWriteMask = eR | eG | eB | eA};
+  vk::PipelineColorBlendStateCreateInfo colorblending{
+      .logicOp = vk::LogicOp::eCopy,
+      .attachmentCount = 1,
+      .pAttachments = &colorblend_attachment};
+  std::array dynamic_states = {vk::DynamicState::eViewport,
+                               vk::DynamicState::eScissor};
+  vk::PipelineDynamicStateCreateInfo dynamicState{
+      .dynamicStateCount = dynamic_states.size(),
+      .pDynamicStates = dynamic_states.data()};
+
+  vk::GraphicsPipelineCreateInfo pipeline_info{
+      .stageCount = stages.size(),
+      .pStages = stages.data(),
+      .pVertexInputState = &vert_in_info,
+      .pInputAssemblyState = &in_assembly,
+      .pViewportState = &viewport_state,
+      .pRasterizationState = &rasterizer,
+      .pMultisampleState = &multisampling,
+      .pColorBlendState = &colorblending,
+      .pDynamicState = &dynamicState,
+      .layout = r.splat_layout,
+      .renderPass = r.pass,
+      .subpass = 0};
+  if (auto &&[err, result] =
+          c.device.createGraphicsPipeline(r.pipeline_cache, pipeline_info);
+      err == vk::Result::eSuccess) {
+    r.splat_graphics_pipe = result;
+  } else {
+    throw std::runtime_error(vk::to_string(err));
   }
-  r.compute_pipe = pipeline;
 }
 
 void setupRenderpass(Context &c, Renderer &r) {
@@ -541,36 +937,64 @@ void setupPool(Context &c, Renderer &r) {
   r.cmd_pool = c.device.createCommandPool(
       {.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
        .queueFamilyIndex = static_cast<uint32_t>(c.indicies.graphics)});
+  r.compute_pool = c.device.createCommandPool(
+      {.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+       .queueFamilyIndex = static_cast<uint32_t>(c.indicies.compute)});
+}
+
+vk::Semaphore createTimeline(vk::Device device) {
+  vk::SemaphoreTypeCreateInfo type{
+      .semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+  return device.createSemaphore({.pNext = &type});
 }
 
 void setupDescPool(Context &c, Renderer &r) {
   auto sizes = std::to_array<vk::DescriptorPoolSize>(
       {{.type = vk::DescriptorType::eUniformBuffer, .descriptorCount = 20},
-       {.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 20}});
-  r.desc_pool = c.device.createDescriptorPool({.maxSets = 40,
+       {.type = vk::DescriptorType::eStorageBuffer, .descriptorCount = 96}});
+  r.desc_pool = c.device.createDescriptorPool({.maxSets = 48,
                                                .poolSizeCount = sizes.size(),
                                                .pPoolSizes = sizes.data()});
 }
 } // namespace
 
 Context::Context(Window &&win)
-    : window(std::move(win)), instance(setupInstance(window)),
-      debug_messager(setupDebug(instance)),
-      surface(window.getSurface(instance)), device(nullptr),
+    : window(std::move(win)), validation(enableValidation),
+      instance(setupInstance(window->getVkExtentions(), validation)),
+      debug_messager(setupDebug(instance, validation)),
+      surface(window->getSurface(instance)), device(nullptr),
       swapchain(nullptr) {
   setupDevice(*this);
+  allocator.emplace(device, phys);
+  pipeline_cache = loadPipelineCache(device, phys);
   format = setupSwapchain(*this);
   setupViews(*this);
 }
+Context::Context(Headless headless)
+    : validation(enableValidation && headless.validation),
+      instance(setupInstance({}, validation)),
+      debug_messager(setupDebug(instance, validation)),
+      surface(nullptr), device(nullptr), swapchain(nullptr) {
+  setupDevice(*this);
+  allocator.emplace(device, phys);
+  pipeline_cache = loadPipelineCache(device, phys);
+}
 Context::~Context() {
   for (auto view : views) {
     device.destroyImageView(view);
   }
   device.destroySwapchainKHR(swapchain);
+  allocator.reset();
+  savePipelineCache(device, phys, pipeline_cache);
+  device.destroyPipelineCache(pipeline_cache);
   device.destroy();
   instance.destroySurfaceKHR(surface);
-  if (auto func = (PFN_vkDestroyDebugUtilsMessengerEXT)instance.getProcAddr(
-          "vkDestroyDebugUtilsMessengerEXT")) {
+  // the debug utils extension is only there with validation
+  auto func = debug_messager
+                  ? (PFN_vkDestroyDebugUtilsMessengerEXT)instance.getProcAddr(
+                        "vkDestroyDebugUtilsMessengerEXT")
+                  : nullptr;
+  if (func) {
     func(instance, (VkDebugUtilsMessengerEXT)debug_messager, nullptr);
   }
   instance.destroy();
@@ -584,12 +1008,27 @@ void Context::recreateSwapchain() {
   setupViews(*this);
 }
 
-Renderer::Renderer(Context &c)
-    : device(c.device), queues(c.queues), swapchain_extent(c.swapchain_extent) {
-  setupRenderpass(c, *this);
-  setupFramebuffers(c, *this);
+Renderer::Renderer(Context &c, Kernel kernel, Sprite sprite)
+    : device(c.device), queues(c.queues), families(c.indicies), kernel(kernel),
+      sprite(sprite), pipeline_cache(c.pipeline_cache),
+      swapchain_extent(c.swapchain_extent) {
+  auto start = std::chrono::steady_clock::now();
   setupCompute(c, *this);
-  setupShaderAndPipeline(c, *this);
+  setupScan(c, *this);
+  setupGrid(c, *this);
+  setupReorder(c, *this);
+  if (kernel == Kernel::verlet)
+    setupVerlet(c, *this);
+  // headless only runs the compute pipelines
+  if (!c.headless()) {
+    setupRenderpass(c, *this);
+    setupFramebuffers(c, *this);
+    setupShaderAndPipeline(c, *this);
+    setupViewPasses(c, *this);
+  }
+  pipeline_ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
   setupPool(c, *this);
   setupDescPool(c, *this);
   for (auto &available : image_available_sem) {
@@ -602,6 +1041,8 @@ Renderer::Renderer(Context &c)
     in_flight =
         c.device.createFence({.flags = vk::FenceCreateFlagBits::eSignaled});
   }
+  sim_timeline = createTimeline(c.device);
+  draw_timeline = createTimeline(c.device);
 }
 Renderer::~Renderer() {
   for (auto sem : image_available_sem) {
@@ -613,13 +1054,41 @@ Renderer::~Renderer() {
   for (auto fence : inflight_fen) {
     device.destroyFence(fence);
   }
+  device.destroySemaphore(sim_timeline);
+  device.destroySemaphore(draw_timeline);
   device.destroyDescriptorPool(desc_pool);
   device.destroyCommandPool(cmd_pool);
+  device.destroyCommandPool(compute_pool);
   device.destroyPipeline(graphics_pipe);
   device.destroyPipelineLayout(layout);
   device.destroyDescriptorSetLayout(descriptor_layout);
   device.destroyPipeline(compute_pipe);
+  device.destroyPipeline(reduce_pipe);
+  device.destroyPipeline(reduce_final_pipe);
+  device.destroyPipeline(grid_count_pipe);
+  destroyScan(device, grid_scan);
+  device.destroyPipeline(grid_scatter_pipe);
+  device.destroyPipeline(grid_collide_pipe);
   device.destroyPipelineLayout(compute_layout);
+  device.destroyPipelineLayout(scan_layout);
+  device.destroyDescriptorSetLayout(scan_desc_layout);
+  device.destroyPipeline(morton_pipe);
+  device.destroyPipeline(radix_count_pipe);
+  destroyScan(device, radix_scan);
+  device.destroyPipeline(radix_scatter_pipe);
+  device.destroyPipeline(reorder_gather_pipe);
+  device.destroyPipelineLayout(reorder_layout);
+  device.destroyDescriptorSetLayout(reorder_desc_layout);
+  device.destroyPipeline(verlet_check_pipe);
+  device.destroyPipeline(verlet_build_pipe);
+  device.destroyPipeline(verlet_collide_pipe);
+  device.destroyPipelineLayout(verlet_layout);
+  device.destroyDescriptorSetLayout(verlet_desc_layout);
+  device.destroyPipeline(cull_pipe);
+  device.destroyPipelineLayout(cull_layout);
+  device.destroyPipeline(splat_pipe);
+  device.destroyPipeline(splat_graphics_pipe);
+  device.destroyPipelineLayout(splat_layout);
   device.destroyDescriptorSetLayout(compute_desc_layout);
   for (auto buffer : framebuffers) {
     device.destroyFramebuffer(buffer);
@@ -637,4 +1106,11 @@ std::vector<vk::CommandBuffer>
 Renderer::getCommands(uint32_t number, vk::CommandBufferLevel level) {
   return device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{
       .commandPool = cmd_pool, .level = level, .commandBufferCount = number});
+}
+
+std::vector<vk::CommandBuffer> Renderer::getComputeCommands(uint32_t number) {
+  return device.allocateCommandBuffers(
+      vk::CommandBufferAllocateInfo{.commandPool = compute_pool,
+                                    .level = vk::CommandBufferLevel::ePrimary,
+                                    .commandBufferCount = number});
 }
\ No newline at end of file
@@ -0,0 +1,604 @@
+#include "simulation.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <limits>
+#include <numeric>
+
+#include "constants.hpp"
+#include "util/vkassert.hpp"
+
+namespace {
+// slots of each neighbour list, matches verlet.glsl
+constexpr uint32_t max_neighbours = 16;
+// a max_displacement past any skin, so the next step builds the lists
+constexpr uint32_t infinity_bits = 0x7f800000;
+// values each invocation of a scan handles per tile, matches scan.glsl
+constexpr uint32_t scan_items = 16;
+
+// workgroups of a scan's passes over every tile
+uint32_t scanBlocks(uint32_t count) {
+  auto tile = world::constants.work_size * scan_items;
+  return (count + tile - 1) / tile;
+}
+
+// sums for every tile of scan's input, bound next to it and the output. the
+// output needs room for the total after the scanned values
+ScanBuffers createScanBuffers(Context &vk, Renderer &r,
+                              const ScanPipes &scan,
+                              std::span<const uint32_t> families,
+                              vk::Buffer in, vk::Buffer out) {
+  using enum vk::BufferUsageFlagBits;
+  using enum vk::MemoryPropertyFlagBits;
+  auto result = ScanBuffers{
+      .sums = Buffer(*vk.allocator, scanBlocks(scan.count) * sizeof(uint32_t),
+                     eStorageBuffer, eDeviceLocal, families),
+      .desc = r.getDescriptors(1, r.scan_desc_layout).front()};
+  auto info = std::to_array<vk::DescriptorBufferInfo>(
+      {{in, 0, VK_WHOLE_SIZE},
+       {out, 0, VK_WHOLE_SIZE},
+       {result.sums.buffer, 0, VK_WHOLE_SIZE}});
+  r.device.updateDescriptorSets(
+      {{.dstSet = result.desc,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = static_cast<uint32_t>(info.size()),
+        .descriptorType = vk::DescriptorType::eStorageBuffer,
+        .pBufferInfo = info.data()}},
+      {});
+  return result;
+}
+
+// records scan's passes over the buffers of desc with barriers in between,
+// binding desc as set 1 and leaving the world bound. dispatch(tiled) records
+// one pass over every tile or over a single workgroup, so the verlet kernel
+// can dispatch them indirectly
+void dispatchScan(Renderer &c, vk::CommandBuffer buffer,
+                  const ScanPipes &scan, vk::DescriptorSet desc,
+                  auto &&dispatch) {
+  using enum vk::PipelineStageFlagBits;
+  buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, c.scan_layout,
+                            1, desc, {});
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, scan.reduce);
+  dispatch(true);
+  computeBarrier(buffer, eComputeShader);
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, scan.blocks);
+  dispatch(false);
+  computeBarrier(buffer, eComputeShader);
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, scan.add);
+  dispatch(true);
+}
+
+void dispatchScan(Renderer &c, vk::CommandBuffer buffer,
+                  const ScanPipes &scan, vk::DescriptorSet desc) {
+  auto blocks = scanBlocks(scan.count);
+  dispatchScan(c, buffer, scan, desc, [&](bool tiled) {
+    buffer.dispatch(tiled ? blocks : 1, 1, 1);
+  });
+}
+
+GridBuffers createGrid(Context &vk, Renderer &r,
+                       std::span<const uint32_t> families) {
+  using enum vk::BufferUsageFlagBits;
+  using enum vk::MemoryPropertyFlagBits;
+  auto cells = world::constants.cellCount();
+  auto grid = GridBuffers{
+      .counts = Buffer(*vk.allocator, cells * sizeof(uint32_t),
+                       eStorageBuffer | eTransferDst, eDeviceLocal, families),
+      .starts = Buffer(*vk.allocator, (cells + 1) * sizeof(uint32_t),
+                       eStorageBuffer, eDeviceLocal, families),
+      .items = Buffer(*vk.allocator,
+                      world::constants.obj_count * sizeof(uint32_t),
+                      eStorageBuffer, eDeviceLocal, families),
+      .scan = {}};
+  grid.scan = createScanBuffers(vk, r, r.grid_scan, families,
+                                grid.counts.buffer, grid.starts.buffer);
+  return grid;
+}
+
+// rebuilds the cell list from the current positions and then runs the
+// neighbour-cell collision pass, expects the world set to be bound. the
+// counts start out at zero and the scatter leaves them there
+void dispatchGrid(Renderer &c, vk::CommandBuffer buffer, GridBuffers &grid) {
+  using enum vk::PipelineStageFlagBits;
+  auto groups = world::constants.groups();
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.grid_count_pipe);
+  buffer.dispatch(groups, 1, 1);
+  computeBarrier(buffer, eComputeShader);
+
+  dispatchScan(c, buffer, c.grid_scan, grid.scan.desc);
+  computeBarrier(buffer, eComputeShader);
+
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.grid_scatter_pipe);
+  buffer.dispatch(groups, 1, 1);
+  computeBarrier(buffer, eComputeShader);
+
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.grid_collide_pipe);
+  buffer.dispatch(groups, 1, 1);
+}
+
+// checks whether the neighbour lists still hold, rebuilds the cell list and
+// the lists out of it if not and collides every particle with its list, with
+// the world set bound. the rebuild's passes are dispatched indirectly so
+// whether they run is decided on the gpu and the steps can be recorded ahead.
+// the collision pass leaves how far the particles got for the next check
+void dispatchVerlet(Renderer &c, vk::CommandBuffer buffer,
+                    vk::DescriptorSet world, GridBuffers &grid,
+                    VerletBuffers &verlet) {
+  using enum vk::PipelineStageFlagBits;
+  buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, c.verlet_layout,
+                            0, std::array{world, verlet.desc}, {});
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.verlet_check_pipe);
+  buffer.dispatch(1, 1, 1);
+  buffer.pipelineBarrier(
+      eComputeShader, eDrawIndirect | eComputeShader, {},
+      vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                        .dstAccessMask =
+                            vk::AccessFlagBits::eIndirectCommandRead |
+                            vk::AccessFlagBits::eShaderRead |
+                            vk::AccessFlagBits::eShaderWrite},
+      {}, {});
+
+  // the same cell list passes as the grid kernel
+  auto particles = offsetof(VerletState, particle_dispatch);
+  auto pass = [&](vk::Pipeline pipe, vk::DeviceSize dispatch) {
+    buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipe);
+    buffer.dispatchIndirect(verlet.state.buffer, dispatch);
+    computeBarrier(buffer, eComputeShader);
+  };
+  pass(c.grid_count_pipe, particles);
+  dispatchScan(c, buffer, c.grid_scan, grid.scan.desc, [&](bool tiled) {
+    buffer.dispatchIndirect(verlet.state.buffer,
+                            tiled ? offsetof(VerletState, block_dispatch)
+                                  : offsetof(VerletState, scan_dispatch));
+  });
+  computeBarrier(buffer, eComputeShader);
+  // the scan's set took the lists' place
+  buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, c.verlet_layout,
+                            1, verlet.desc, {});
+  pass(c.grid_scatter_pipe, particles);
+  pass(c.verlet_build_pipe, particles);
+
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.verlet_collide_pipe);
+  buffer.dispatch(world::constants.groups(), 1, 1);
+}
+
+VerletBuffers createVerlet(Context &vk, Renderer &r,
+                           std::span<const uint32_t> families) {
+  using enum vk::BufferUsageFlagBits;
+  using enum vk::MemoryPropertyFlagBits;
+  auto count = world::constants.obj_count;
+  auto verlet = VerletBuffers{
+      .lists = Buffer(*vk.allocator,
+                      count * max_neighbours * sizeof(uint32_t),
+                      eStorageBuffer, eDeviceLocal, families),
+      .counts = Buffer(*vk.allocator, count * sizeof(uint32_t),
+                       eStorageBuffer, eDeviceLocal, families),
+      .origins = Buffer(*vk.allocator, count * sizeof(glm::vec2),
+                        eStorageBuffer, eDeviceLocal, families),
+      .state = Buffer(*vk.allocator, sizeof(VerletState),
+                      eStorageBuffer | eIndirectBuffer | eTransferSrc |
+                          eTransferDst,
+                      eDeviceLocal, families),
+      .desc = r.getDescriptors(1, r.verlet_desc_layout).front()};
+  auto info = std::to_array<vk::DescriptorBufferInfo>(
+      {{verlet.lists.buffer, 0, VK_WHOLE_SIZE},
+       {verlet.counts.buffer, 0, VK_WHOLE_SIZE},
+       {verlet.origins.buffer, 0, VK_WHOLE_SIZE},
+       {verlet.state.buffer, 0, VK_WHOLE_SIZE}});
+  r.device.updateDescriptorSets(
+      {{.dstSet = verlet.desc,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorCount = static_cast<uint32_t>(info.size()),
+        .descriptorType = vk::DescriptorType::eStorageBuffer,
+        .pBufferInfo = info.data()}},
+      {});
+  return verlet;
+}
+
+// one set per step parity, parity p reads world[p] and writes world[1 - p]
+// the rest of the buffers are bound in order after the world bindings
+std::array<vk::DescriptorSet, 2>
+createDescs(Renderer &vk, std::array<vk::Buffer, 2> world,
+            const WorldLayout &layout, std::span<const vk::Buffer> buffers) {
+  auto descs = vk.getDescriptors(2, vk.compute_desc_layout);
+  std::array<vk::DescriptorSet, 2> result;
+  for (size_t i = 0; i < result.size(); i++) {
+    std::vector<vk::DescriptorBufferInfo> buffer_info;
+    std::ranges::copy(layout.describe(world[i]),
+                      std::back_inserter(buffer_info));
+    std::ranges::copy(layout.describe(world[1 - i]),
+                      std::back_inserter(buffer_info));
+    for (auto buffer : buffers) {
+      buffer_info.push_back(
+          {.buffer = buffer, .offset = 0, .range = VK_WHOLE_SIZE});
+    }
+    vk.device.updateDescriptorSets(
+        {{.dstSet = descs[i],
+          .dstBinding = 0,
+          .dstArrayElement = 0,
+          .descriptorCount = static_cast<uint32_t>(buffer_info.size()),
+          .descriptorType = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo = buffer_info.data()}},
+        {});
+    result[i] = descs[i];
+  }
+  return result;
+}
+
+// the ids start out as the slots, the sort's sets bind the two key and slot
+// arrays in opposite directions
+ReorderBuffers createReorder(Context &vk, Renderer &r, StagingRing &staging,
+                             std::span<const uint32_t> families,
+                             uint32_t every) {
+  using enum vk::BufferUsageFlagBits;
+  using enum vk::MemoryPropertyFlagBits;
+  auto count = world::constants.obj_count;
+  auto array = [&](vk::BufferUsageFlags usage = {}) {
+    return Buffer(*vk.allocator, count * sizeof(uint32_t),
+                  eStorageBuffer | usage, eDeviceLocal, families);
+  };
+  auto reorder = ReorderBuffers{
+      .every = every,
+      .keys = {array(), array()},
+      .values = {array(), array()},
+      .histogram = Buffer(*vk.allocator,
+                          (world::constants.radixDigits() + 1) *
+                              sizeof(uint32_t),
+                          eStorageBuffer, eDeviceLocal, families),
+      .scan = {},
+      .ids = array(eTransferSrc | eTransferDst),
+      .ids_next = array(eTransferSrc),
+      .descs = {}};
+  reorder.scan =
+      createScanBuffers(vk, r, r.radix_scan, families,
+                        reorder.histogram.buffer, reorder.histogram.buffer);
+
+  auto descs = r.getDescriptors(2, r.reorder_desc_layout);
+  for (size_t i = 0; i < descs.size(); i++) {
+    auto info = std::to_array<vk::DescriptorBufferInfo>(
+        {{reorder.keys[i].buffer, 0, VK_WHOLE_SIZE},
+         {reorder.values[i].buffer, 0, VK_WHOLE_SIZE},
+         {reorder.keys[1 - i].buffer, 0, VK_WHOLE_SIZE},
+         {reorder.values[1 - i].buffer, 0, VK_WHOLE_SIZE},
+         {reorder.histogram.buffer, 0, VK_WHOLE_SIZE},
+         {reorder.ids.buffer, 0, VK_WHOLE_SIZE},
+         {reorder.ids_next.buffer, 0, VK_WHOLE_SIZE}});
+    r.device.updateDescriptorSets(
+        {{.dstSet = descs[i],
+          .dstBinding = 0,
+          .dstArrayElement = 0,
+          .descriptorCount = static_cast<uint32_t>(info.size()),
+          .descriptorType = vk::DescriptorType::eStorageBuffer,
+          .pBufferInfo = info.data()}},
+        {});
+    reorder.descs[i] = descs[i];
+  }
+
+  auto ids = std::vector<uint32_t>(count);
+  std::iota(ids.begin(), ids.end(), 0);
+  staging.upload(reorder.ids.buffer, bin(ids));
+  return reorder;
+}
+
+void uploadWorld(StagingRing &staging, Buffer &buffer,
+                 const WorldLayout &layout, std::span<const glm::vec2> pos,
+                 std::span<const glm::vec2> vel,
+                 std::span<const uint32_t> color) {
+  staging.upload(buffer.buffer, bin(pos), layout.pos);
+  uploadVelocities(staging, buffer.buffer, layout, vel);
+  staging.upload(buffer.buffer, bin(color), layout.color);
+  staging.flush();
+}
+
+} // namespace
+
+void uploadVelocities(StagingRing &staging, vk::Buffer buffer,
+                      const WorldLayout &layout,
+                      std::span<const glm::vec2> vel) {
+  if (layout.half_velocity)
+    staging.upload(buffer, bin(packVelocities(vel)), layout.vel);
+  else
+    staging.upload(buffer, bin(vel), layout.vel);
+}
+
+void computeBarrier(vk::CommandBuffer buffer, vk::PipelineStageFlags dst,
+                    vk::PipelineStageFlags src) {
+  using enum vk::AccessFlagBits;
+  auto written = vk::AccessFlags();
+  if (src & vk::PipelineStageFlagBits::eTransfer)
+    written |= eTransferWrite;
+  if (src & vk::PipelineStageFlagBits::eComputeShader)
+    written |= eShaderWrite;
+  auto access = vk::AccessFlags(eShaderRead | eShaderWrite);
+  if (dst & vk::PipelineStageFlagBits::eTransfer)
+    access |= eTransferRead | eTransferWrite;
+  buffer.pipelineBarrier(
+      src, dst, {},
+      vk::MemoryBarrier{.srcAccessMask = written, .dstAccessMask = access}, {},
+      {});
+}
+
+void ownershipBarrier(vk::CommandBuffer buffer, vk::Buffer target,
+                      uint32_t from, uint32_t to, vk::PipelineStageFlags src,
+                      vk::AccessFlags src_access, vk::PipelineStageFlags dst,
+                      vk::AccessFlags dst_access) {
+  if (from == to)
+    return;
+  buffer.pipelineBarrier(src, dst, {}, {},
+                         vk::BufferMemoryBarrier{.srcAccessMask = src_access,
+                                                 .dstAccessMask = dst_access,
+                                                 .srcQueueFamilyIndex = from,
+                                                 .dstQueueFamilyIndex = to,
+                                                 .buffer = target,
+                                                 .offset = 0,
+                                                 .size = VK_WHOLE_SIZE},
+                         {});
+}
+
+std::vector<uint32_t> simulationFamilies(Context &vk) {
+  auto families = std::vector<uint32_t>();
+  for (int family : {vk.indicies.graphics, vk.indicies.transfer,
+                     vk.indicies.compute}) {
+    if (std::ranges::find(families, family) == families.end())
+      families.push_back(family);
+  }
+  return families;
+}
+
+Simulation createSimulation(Context &context, Renderer &vk,
+                            StagingRing &staging, const Checkpoint *restore,
+                            uint32_t reorder_every) {
+  using enum vk::BufferUsageFlagBits;
+  using enum vk::MemoryPropertyFlagBits;
+  auto families = simulationFamilies(context);
+  auto layout = WorldLayout(world::constants.obj_count);
+  auto world_buf = [&] {
+    return Buffer(*context.allocator, layout.size,
+                  eStorageBuffer | eTransferSrc | eTransferDst, eDeviceLocal,
+                  families);
+  };
+  auto sim = Simulation{
+      .layout = layout,
+      .world = {world_buf(), world_buf()},
+      // a collision counter and padding, then one 16 byte partial per
+      // workgroup
+      .reduction = Buffer(*context.allocator,
+                          2 * sizeof(uint32_t) +
+                              world::constants.groups() * sizeof(glm::vec4),
+                          eStorageBuffer | eTransferDst, eDeviceLocal,
+                          families),
+      .observables = MappedBuffer<Observables>(
+          *context.allocator, eStorageBuffer | eTransferDst,
+          frames_in_flight, families),
+      .grid = createGrid(context, vk, families)};
+  if (reorder_every != 0)
+    sim.reorder =
+        createReorder(context, vk, staging, families, reorder_every);
+  if (vk.kernel == Kernel::verlet)
+    sim.verlet = createVerlet(context, vk, families);
+
+  vk.execute_immediately([&](vk::CommandBuffer cmd) {
+    static_assert(sizeof(float) == sizeof(uint32_t),
+                  "size of float and uint32 don't match");
+    for (auto &world_buf : sim.world) {
+      cmd.fillBuffer(
+          world_buf.buffer, 0, vk::WholeSize,
+          std::bit_cast<uint32_t>(std::numeric_limits<float>::quiet_NaN()));
+    }
+    cmd.fillBuffer(sim.reduction.buffer, 0, vk::WholeSize, 0);
+    cmd.fillBuffer(sim.observables.buffer.buffer, 0, vk::WholeSize, 0);
+    // the scatter leaves the counts at zero after every step
+    cmd.fillBuffer(sim.grid.counts.buffer, 0, vk::WholeSize, 0);
+    if (sim.verlet) {
+      // builds the lists on the first step
+      cmd.fillBuffer(sim.verlet->state.buffer, 0, vk::WholeSize, 0);
+      cmd.fillBuffer(sim.verlet->state.buffer,
+                     offsetof(VerletState, max_displacement),
+                     sizeof(uint32_t), infinity_bits);
+    }
+  });
+
+  sim.descs = createDescs(
+      vk, {sim.world[0].buffer, sim.world[1].buffer}, layout,
+      std::to_array({sim.reduction.buffer, sim.grid.counts.buffer,
+                     sim.grid.starts.buffer, sim.grid.items.buffer,
+                     sim.observables.buffer.buffer}));
+  if (restore) {
+    // the ring copies straight out of the mapping, nothing is parsed
+    uploadWorld(staging, sim.world[0], layout, restore->pos(), restore->vel(),
+                restore->color());
+    sim.step = restore->header().step;
+  } else {
+    auto world = genWorld();
+    uploadWorld(staging, sim.world[0], layout, world.pos, world.vel,
+                world.color);
+  }
+  return sim;
+}
+
+void saveCheckpoint(const std::filesystem::path &path, Context &context,
+                    Renderer &vk, Simulation &sim) {
+  using enum vk::MemoryPropertyFlagBits;
+  vk.device.waitIdle();
+  auto count = sim.layout.count;
+  // the ids go after the world
+  auto ids_size = sim.reorder ? count * sizeof(uint32_t) : 0;
+  auto readback = Buffer(*context.allocator, sim.layout.size + ids_size,
+                         vk::BufferUsageFlagBits::eTransferDst,
+                         eHostVisible | eHostCoherent);
+  vk.execute_immediately([&](vk::CommandBuffer cmd) {
+    cmd.copyBuffer(sim.world[sim.parity].buffer, readback.buffer,
+                   vk::BufferCopy{0, 0, sim.layout.size});
+    if (sim.reorder)
+      cmd.copyBuffer(sim.reorder->ids.buffer, readback.buffer,
+                     vk::BufferCopy{0, sim.layout.size, ids_size});
+  });
+  auto bytes = static_cast<const std::byte *>(readback.mem.mapped);
+  auto pos = std::span(
+      reinterpret_cast<const glm::vec2 *>(bytes + sim.layout.pos), count);
+  auto vel = std::span(
+      reinterpret_cast<const glm::vec2 *>(bytes + sim.layout.vel), count);
+  auto color = std::span(
+      reinterpret_cast<const uint32_t *>(bytes + sim.layout.color), count);
+  // checkpoints always hold full floats
+  std::vector<glm::vec2> unpacked;
+  if (sim.layout.half_velocity) {
+    unpacked.resize(count);
+    unpackVelocities(
+        {reinterpret_cast<const uint32_t *>(bytes + sim.layout.vel), count},
+        unpacked);
+    vel = unpacked;
+  }
+  if (!sim.reorder) {
+    writeCheckpoint(path, sim.step, pos, vel, color);
+    return;
+  }
+  // back in the order the particles were made in, so a restored world
+  // starts with the same ids
+  auto ids = reinterpret_cast<const uint32_t *>(bytes + sim.layout.size);
+  auto world = WorldS{.pos = std::vector<glm::vec2>(count),
+                      .vel = std::vector<glm::vec2>(count),
+                      .color = std::vector<uint32_t>(count)};
+  for (size_t i = 0; i < count; i++) {
+    world.pos[ids[i]] = pos[i];
+    world.vel[ids[i]] = vel[i];
+    world.color[ids[i]] = color[i];
+  }
+  writeCheckpoint(path, sim.step, world.pos, world.vel, world.color);
+}
+
+VerletState readVerletState(Context &context, Renderer &vk, Simulation &sim) {
+  using enum vk::MemoryPropertyFlagBits;
+  vk.device.waitIdle();
+  auto readback = Buffer(*context.allocator, sizeof(VerletState),
+                         vk::BufferUsageFlagBits::eTransferDst,
+                         eHostVisible | eHostCoherent);
+  vk.execute_immediately([&](vk::CommandBuffer cmd) {
+    cmd.copyBuffer(sim.verlet->state.buffer, readback.buffer,
+                   vk::BufferCopy{0, 0, sizeof(VerletState)});
+  });
+  VerletState state;
+  std::memcpy(&state, readback.mem.mapped, sizeof(state));
+  return state;
+}
+
+void recordStep(Renderer &c, vk::CommandBuffer buffer, Simulation &sim,
+                float dt) {
+  auto step = StepConstants{.dt = dt};
+  auto world = sim.descs[sim.parity];
+  buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, c.compute_layout,
+                            0, world, {});
+  buffer.pushConstants(c.compute_layout, vk::ShaderStageFlagBits::eCompute, 0,
+                       vk::ArrayProxy<const StepConstants>(1, &step));
+  if (c.kernel == Kernel::grid) {
+    dispatchGrid(c, buffer, sim.grid);
+  } else if (c.kernel == Kernel::verlet) {
+    dispatchVerlet(c, buffer, world, sim.grid, *sim.verlet);
+  } else {
+    buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.compute_pipe);
+    buffer.dispatch(world::constants.groups(), 1, 1);
+  }
+}
+
+void recordReorder(Renderer &c, vk::CommandBuffer buffer, Simulation &sim) {
+  using enum vk::PipelineStageFlagBits;
+  auto &reorder = *sim.reorder;
+  auto groups = world::constants.groups();
+  auto tiles = world::constants.radixTiles();
+  // only the bits the grid's cells reach are sorted on, a few hundred cells
+  // a side takes two passes
+  auto side = std::max(world::constants.grid_w, world::constants.grid_h);
+  auto bits = 2 * static_cast<uint32_t>(std::bit_width(side - 1));
+  auto passes = std::max(
+      1u, (bits + world::radix_bits - 1) / world::radix_bits);
+  auto bind = [&](uint32_t set) {
+    buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                              c.reorder_layout, 0,
+                              std::array{sim.descs[sim.parity],
+                                         reorder.descs[set]},
+                              {});
+  };
+
+  bind(0);
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.morton_pipe);
+  buffer.dispatch(groups, 1, 1);
+  for (uint32_t pass = 0; pass < passes; pass++) {
+    computeBarrier(buffer, eComputeShader);
+    bind(pass % 2);
+    auto constants = RadixConstants{.shift = pass * world::radix_bits};
+    buffer.pushConstants(c.reorder_layout, vk::ShaderStageFlagBits::eCompute,
+                         0,
+                         vk::ArrayProxy<const RadixConstants>(1, &constants));
+    buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.radix_count_pipe);
+    buffer.dispatch(tiles, 1, 1);
+    computeBarrier(buffer, eComputeShader);
+    dispatchScan(c, buffer, c.radix_scan, reorder.scan.desc);
+    computeBarrier(buffer, eComputeShader);
+    // the scan's set took the sort's place, its push constant range is the
+    // same size so the shift stays
+    bind(pass % 2);
+    buffer.bindPipeline(vk::PipelineBindPoint::eCompute,
+                        c.radix_scatter_pipe);
+    buffer.dispatch(tiles, 1, 1);
+  }
+
+  computeBarrier(buffer, eComputeShader);
+  bind(passes % 2);
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.reorder_gather_pipe);
+  buffer.dispatch(groups, 1, 1);
+  computeBarrier(buffer, eTransfer);
+  buffer.copyBuffer(reorder.ids_next.buffer, reorder.ids.buffer,
+                    vk::BufferCopy{0, 0, sim.layout.count * sizeof(uint32_t)});
+  computeBarrier(buffer, eComputeShader | eTransfer,
+                 eComputeShader | eTransfer);
+  sim.parity ^= 1;
+}
+
+void recordSteps(Renderer &c, vk::CommandBuffer buffer, Simulation &sim,
+                 unsigned steps, float dt) {
+  for (unsigned k = 0; k < steps; k++) {
+    if (k != 0)
+      computeBarrier(buffer, vk::PipelineStageFlagBits::eComputeShader);
+    recordStep(c, buffer, sim, dt);
+    sim.parity ^= 1;
+    sim.step++;
+    if (sim.reorder && sim.step % sim.reorder->every == 0) {
+      computeBarrier(buffer, vk::PipelineStageFlagBits::eComputeShader);
+      recordReorder(c, buffer, sim);
+      // the lists name slots, which the sort just shuffled
+      if (sim.verlet) {
+        buffer.fillBuffer(sim.verlet->state.buffer,
+                          offsetof(VerletState, max_displacement),
+                          sizeof(uint32_t), infinity_bits);
+        computeBarrier(buffer, vk::PipelineStageFlagBits::eComputeShader,
+                       vk::PipelineStageFlagBits::eTransfer);
+      }
+    }
+  }
+}
+
+void recordReduce(Renderer &c, vk::CommandBuffer buffer,
+                  vk::DescriptorSet world, uint32_t slot) {
+  auto constants = StepConstants{.dt = 0, .slot = slot};
+  buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, c.compute_layout,
+                            0, world, {});
+  buffer.pushConstants(c.compute_layout, vk::ShaderStageFlagBits::eCompute, 0,
+                       vk::ArrayProxy<const StepConstants>(1, &constants));
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.reduce_pipe);
+  buffer.dispatch(world::constants.groups(), 1, 1);
+  computeBarrier(buffer, vk::PipelineStageFlagBits::eComputeShader);
+  buffer.bindPipeline(vk::PipelineBindPoint::eCompute, c.reduce_final_pipe);
+  buffer.dispatch(1, 1, 1);
+  buffer.pipelineBarrier(
+      vk::PipelineStageFlagBits::eComputeShader,
+      vk::PipelineStageFlagBits::eHost, {},
+      vk::MemoryBarrier{.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                        .dstAccessMask = vk::AccessFlagBits::eHostRead},
+      {}, {});
+}
@@ -0,0 +1,140 @@
+#include "staging.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "util/vkassert.hpp"
+
+namespace {
+// keeps every copy's source offset aligned the way drivers copy fastest
+constexpr vk::DeviceSize copy_alignment = 16;
+
+vk::DeviceSize alignUp(vk::DeviceSize size) {
+  return (size + copy_alignment - 1) / copy_alignment * copy_alignment;
+}
+} // namespace
+
+StagingRing::StagingRing(Context &context, Renderer &vk, vk::DeviceSize size)
+    : device(vk.device), queue(vk.queues.mem()),
+      pool(device.createCommandPool(
+          {.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+           .queueFamilyIndex = static_cast<uint32_t>(vk.families.transfer)})),
+      ring(*context.allocator, alignUp(size),
+           vk::BufferUsageFlagBits::eTransferSrc,
+           vk::MemoryPropertyFlagBits::eHostVisible |
+               vk::MemoryPropertyFlagBits::eHostCoherent),
+      mapped(static_cast<uint8_t *>(ring.mem.mapped)), size(alignUp(size)) {
+  vk::SemaphoreTypeCreateInfo type{
+      .semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0};
+  timeline = device.createSemaphore({.pNext = &type});
+}
+
+StagingRing::~StagingRing() {
+  wait(submitted);
+  device.destroySemaphore(timeline);
+  device.destroyCommandPool(pool);
+}
+
+void StagingRing::retire() {
+  auto done = device.getSemaphoreCounterValue(timeline);
+  while (!in_flight.empty() && in_flight.front().value <= done) {
+    auto &batch = in_flight.front();
+    tail = (tail + batch.bytes) % size;
+    used -= batch.bytes;
+    spare.push_back(batch.cmd);
+    in_flight.pop_front();
+  }
+}
+
+vk::DeviceSize StagingRing::reserve(vk::DeviceSize bytes) {
+  while (true) {
+    retire();
+    if (used == 0)
+      head = tail = 0;
+    auto wrapped = head < tail || (head == tail && used != 0);
+    if (!wrapped && size - head >= bytes) {
+      // fits before the end
+    } else if (!wrapped && tail >= bytes) {
+      // skip the end, the batch gives the skipped bytes back with its own
+      current.bytes += size - head;
+      used += size - head;
+      head = 0;
+    } else if (wrapped && tail - head >= bytes) {
+      // fits between the newest and oldest batch
+    } else {
+      // everything free is taken by the batches in flight, the oldest has to
+      // finish first. the current one might be all there is
+      if (in_flight.empty())
+        flush();
+      wait(in_flight.front().value);
+      continue;
+    }
+    auto offset = head;
+    head = (head + bytes) % size;
+    used += bytes;
+    current.bytes += bytes;
+    return offset;
+  }
+}
+
+void StagingRing::upload(vk::Buffer dst, std::span<const uint8_t> data,
+                         vk::DeviceSize offset) {
+  // anything bigger than half the ring goes through in pieces so one piece
+  // can be copied while the next is written
+  auto chunk = size / 2;
+  while (!data.empty()) {
+    auto piece = data.first(std::min<size_t>(data.size(), chunk));
+    auto source = reserve(alignUp(piece.size()));
+    std::memcpy(mapped + source, piece.data(), piece.size());
+
+    if (!current.cmd) {
+      if (spare.empty()) {
+        current.cmd = device.allocateCommandBuffers(
+            {.commandPool = pool,
+             .level = vk::CommandBufferLevel::ePrimary,
+             .commandBufferCount = 1})[0];
+      } else {
+        current.cmd = spare.back();
+        spare.pop_back();
+      }
+      current.cmd.reset();
+      vk::CommandBufferBeginInfo info{
+          .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit};
+      vkassert(current.cmd.begin(&info));
+    }
+    current.cmd.copyBuffer(ring.buffer, dst,
+                           vk::BufferCopy{source, offset, piece.size()});
+    offset += piece.size();
+    data = data.subspan(piece.size());
+  }
+}
+
+uint64_t StagingRing::flush() {
+  if (!current.cmd)
+    return submitted;
+  current.cmd.end();
+  current.value = ++submitted;
+  vk::TimelineSemaphoreSubmitInfo signal{.signalSemaphoreValueCount = 1,
+                                         .pSignalSemaphoreValues =
+                                             &current.value};
+  queue.submit(vk::SubmitInfo{.pNext = &signal,
+                              .commandBufferCount = 1,
+                              .pCommandBuffers = &current.cmd,
+                              .signalSemaphoreCount = 1,
+                              .pSignalSemaphores = &timeline});
+  in_flight.push_back(current);
+  current = {};
+  return submitted;
+}
+
+void StagingRing::wait(uint64_t value) {
+  if (value == 0)
+    return;
+  vkassert(device.waitSemaphores(
+      {.semaphoreCount = 1, .pSemaphores = &timeline, .pValues = &value},
+      UINT64_MAX));
+  retire();
+}
@@ -0,0 +1,79 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 1; i < threads; i++) {
+    workers.emplace_back([this, i] { run(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    auto lock = std::lock_guard(mutex);
+    stopping = true;
+  }
+  start.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(
+    size_t count, size_t grain,
+    const std::function<void(size_t, size_t, unsigned)> &body) {
+  if (count == 0)
+    return;
+  {
+    auto lock = std::lock_guard(mutex);
+    this->body = &body;
+    this->count = count;
+    this->grain = std::max<size_t>(grain, 1);
+    next = 0;
+    busy = workers.size();
+    generation++;
+  }
+  start.notify_all();
+  work(0);
+  auto lock = std::unique_lock(mutex);
+  done.wait(lock, [&] { return busy == 0; });
+  this->body = nullptr;
+}
+
+void ThreadPool::run(unsigned thread) {
+  size_t seen = 0;
+  while (true) {
+    {
+      auto lock = std::unique_lock(mutex);
+      start.wait(lock, [&] { return stopping || generation != seen; });
+      if (stopping)
+        return;
+      seen = generation;
+    }
+    work(thread);
+    {
+      auto lock = std::lock_guard(mutex);
+      busy--;
+    }
+    done.notify_one();
+  }
+}
+
+// chunks are handed out under the lock, they're coarse enough that it's
+// never contended for long
+void ThreadPool::work(unsigned thread) {
+  while (true) {
+    size_t begin, end;
+    {
+      auto lock = std::lock_guard(mutex);
+      if (next >= count)
+        return;
+      begin = next;
+      end = std::min(count, begin + grain);
+      next = end;
+    }
+    (*body)(begin, end, thread);
+  }
+}
@@ -0,0 +1,98 @@
+#include "trajectory.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+int32_t quantize(float value, float scale) {
+  auto scaled = std::round(double(value) * scale);
+  return static_cast<int32_t>(
+      std::clamp<double>(scaled, INT32_MIN, INT32_MAX));
+}
+
+void putVarint(std::vector<uint8_t> &out, int32_t delta) {
+  auto zigzag = (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+  while (zigzag >= 0x80) {
+    out.push_back(uint8_t(zigzag | 0x80));
+    zigzag >>= 7;
+  }
+  out.push_back(uint8_t(zigzag));
+}
+
+int32_t getVarint(std::span<const uint8_t> in, size_t &at) {
+  uint32_t zigzag = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (at == in.size())
+      throw std::runtime_error("trajectory frame ends mid value");
+    auto byte = in[at++];
+    zigzag |= uint32_t(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return int32_t(zigzag >> 1) ^ -int32_t(zigzag & 1);
+  }
+  throw std::runtime_error("trajectory frame holds an oversized value");
+}
+
+// the four planes in storage order
+template <typename F> void planes(size_t count, F &&plane) {
+  plane(0 * count, &glm::vec2::x, true);
+  plane(1 * count, &glm::vec2::y, true);
+  plane(2 * count, &glm::vec2::x, false);
+  plane(3 * count, &glm::vec2::y, false);
+}
+} // namespace
+
+FrameEncoder::FrameEncoder(const TrajectoryHeader &header)
+    : header(header), previous(4 * size_t(header.count)) {}
+
+FrameHeader FrameEncoder::encode(uint64_t step, std::span<const glm::vec2> pos,
+                                 std::span<const glm::vec2> vel,
+                                 std::vector<uint8_t> &out) {
+  auto keyframe = frames++ % header.keyframe_interval == 0;
+  if (keyframe)
+    std::ranges::fill(previous, 0);
+  out.clear();
+  auto count = pos.size();
+  planes(count, [&](size_t base, float glm::vec2::*axis, bool is_pos) {
+    auto source = is_pos ? pos : vel;
+    auto scale = 1 / (is_pos ? header.pos_quantum : header.vel_quantum);
+    for (size_t i = 0; i < count; i++) {
+      auto q = quantize(source[i].*axis, scale);
+      // wraps like the decoder's addition does, so any jump round trips
+      putVarint(out, int32_t(uint32_t(q) - uint32_t(previous[base + i])));
+      previous[base + i] = q;
+    }
+  });
+  return {.step = step,
+          .bytes = static_cast<uint32_t>(out.size()),
+          .keyframe = keyframe};
+}
+
+FrameDecoder::FrameDecoder(const TrajectoryHeader &header)
+    : header(header), previous(4 * size_t(header.count)) {}
+
+void FrameDecoder::decode(const FrameHeader &frame,
+                          std::span<const uint8_t> payload,
+                          std::span<glm::vec2> pos, std::span<glm::vec2> vel) {
+  if (frame.keyframe) {
+    std::ranges::fill(previous, 0);
+    primed = true;
+  } else if (!primed) {
+    throw std::runtime_error("trajectory delta frame without a keyframe");
+  }
+  size_t at = 0;
+  auto count = pos.size();
+  planes(count, [&](size_t base, float glm::vec2::*axis, bool is_pos) {
+    auto target = is_pos ? pos : vel;
+    auto quantum = is_pos ? header.pos_quantum : header.vel_quantum;
+    for (size_t i = 0; i < count; i++) {
+      auto q = int32_t(uint32_t(previous[base + i]) +
+                       uint32_t(getVarint(payload, at)));
+      previous[base + i] = q;
+      target[i].*axis = float(q * double(quantum));
+    }
+  });
+  if (at != payload.size())
+    throw std::runtime_error("trajectory frame has trailing bytes");
+}
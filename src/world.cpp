@@ -0,0 +1,91 @@
+#include "world.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <glm/gtc/packing.hpp>
+
+#include "constants.hpp"
+
+namespace {
+vk::DeviceSize align(vk::DeviceSize offset) {
+  return (offset + WorldLayout::alignment - 1) / WorldLayout::alignment *
+         WorldLayout::alignment;
+}
+
+int signrand() { return std::rand() * (std::rand() % 2 ? 1 : -1); }
+} // namespace
+
+uint32_t packColor(glm::vec4 color) { return glm::packUnorm4x8(color); }
+
+glm::vec4 unpackColor(uint32_t color) { return glm::unpackUnorm4x8(color); }
+
+std::vector<uint32_t> packVelocities(std::span<const glm::vec2> vel) {
+  std::vector<uint32_t> packed(vel.size());
+  std::ranges::transform(vel, packed.begin(),
+                         [](glm::vec2 v) { return glm::packHalf2x16(v); });
+  return packed;
+}
+
+void unpackVelocities(std::span<const uint32_t> packed,
+                      std::span<glm::vec2> vel) {
+  std::ranges::transform(packed, vel.begin(),
+                         [](uint32_t v) { return glm::unpackHalf2x16(v); });
+}
+
+WorldLayout::WorldLayout(size_t count)
+    : count(count), half_velocity(world::constants.half_velocity != 0) {
+  pos = 0;
+  vel = align(pos + count * sizeof(glm::vec2));
+  color = align(vel + count * velSize());
+  size = align(color + count * sizeof(uint32_t));
+}
+
+vk::DeviceSize WorldLayout::velSize() const noexcept {
+  return half_velocity ? sizeof(uint32_t) : sizeof(glm::vec2);
+}
+
+vk::DeviceSize WorldLayout::particleSize() const noexcept {
+  return sizeof(glm::vec2) + velSize() + sizeof(uint32_t);
+}
+
+std::array<vk::DescriptorBufferInfo, 3>
+WorldLayout::describe(vk::Buffer buffer) const {
+  return {vk::DescriptorBufferInfo{.buffer = buffer,
+                                   .offset = pos,
+                                   .range = count * sizeof(glm::vec2)},
+          vk::DescriptorBufferInfo{.buffer = buffer,
+                                   .offset = vel,
+                                   .range = count * velSize()},
+          vk::DescriptorBufferInfo{.buffer = buffer,
+                                   .offset = color,
+                                   .range = count * sizeof(uint32_t)}};
+}
+
+WorldS genWorld() {
+  auto count = world::constants.obj_count;
+  auto max_x = world::constants.max_x, max_y = world::constants.max_y;
+  WorldS world{.pos = std::vector<glm::vec2>(count),
+               .vel = std::vector<glm::vec2>(count),
+               .color = std::vector<uint32_t>(count)};
+  srand(std::time(nullptr));
+  float x = 0, y = 0;
+  for (auto &s : world.pos) {
+    s = {x, y};
+    x += max_x / std::sqrt(count);
+    if (x > max_x - world::radius) {
+      x = 0;
+      y += max_y / std::sqrt(count);
+    }
+  }
+  world.pos[0] = {6.8, 9};
+  world.pos[1] = {5, 5};
+  for (auto &v : world.vel) {
+    v = {2 * signrand() / float(RAND_MAX), 2 * signrand() / float(RAND_MAX)};
+  }
+  world.vel[0] = {0, -1};
+  world.vel[1] = {0, 1};
+  std::ranges::fill(world.color, packColor(glm::vec4(0.2, 0.2, 0.2, 0.2)));
+  return world;
+}